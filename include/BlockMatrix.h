@@ -0,0 +1,79 @@
+// =============================================================================
+// SpinXForm -- BlockMatrix.h
+//
+// BlockMatrix is a compressed sparse row (CSR) matrix with quaternion-valued
+// entries, intended for matrix-vector products in iterative solvers and
+// residual checks.  Each nonzero is stored as a single quaternion (4 doubles)
+// rather than as the 16 doubles of the 4x4 real block it represents (see
+// Quaternion::toMatrix()); blocks are expanded on the fly inside the product
+// kernels.  Relative to the real matrix returned by QuaternionMatrix::toReal(),
+// this takes a quarter of the memory for values, and three (32-bit) indices
+// per quaternion instead of sixteen (64-bit) indices.  For example,
+//
+//    QuaternionMatrix A;
+//    ...
+//    BlockMatrix B( A );
+//    B.multiply( x, y ); // y = Ax
+//
+// Products are computed in parallel using OpenMP.  Products with the
+// transpose of the real matrix (i.e., the quaternionic conjugate transpose)
+// use a column index built along with the matrix, so they can be
+// parallelized over rows of the result in the same way.
+//
+
+#ifndef SPINXFORM_BLOCK_MATRIX_H
+#define SPINXFORM_BLOCK_MATRIX_H
+
+#include <vector>
+#include "Quaternion.h"
+#include "QuaternionMatrix.h"
+
+using namespace std;
+
+class BlockMatrix
+{
+   public:
+      BlockMatrix( void );
+      // creates an empty matrix
+
+      BlockMatrix( const QuaternionMatrix& A );
+      // creates a copy of A
+
+      void build( const QuaternionMatrix& A );
+      // replaces this matrix with a copy of A
+
+      int size( int dim ) const;
+      // returns the size of the dimension specified by scalar dim
+
+      int nBlocks( void ) const;
+      // returns the number of nonzero (quaternion) entries
+
+      void getDiagonal( vector<Quaternion>& d ) const;
+      // copies the diagonal entries into d (zero where no entry is stored)
+
+      void multiply( const vector<Quaternion>& x, vector<Quaternion>& y ) const;
+      // computes y = Ax, resizing y if necessary
+
+      void multiplyTranspose( const vector<Quaternion>& x, vector<Quaternion>& y ) const;
+      // computes y = A'x, where A' is the transpose of the real matrix
+      // (i.e., each entry is conjugated and the matrix transposed),
+      // resizing y if necessary
+
+   protected:
+      int m, n;
+      // rows, columns
+
+      vector<int> rowStart, column;
+      // offset of the first entry of each row (plus one final value),
+      // and the column of each entry
+
+      vector<Quaternion> values;
+      // nonzero entries, row by row
+
+      vector<int> columnStart, entry, entryRow;
+      // offset of the first entry of each column in "entry" (plus one
+      // final value), and the index into "values" and the row of each
+      // entry of each column, sorted by row
+};
+
+#endif
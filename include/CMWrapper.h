@@ -46,6 +46,9 @@
 
 #include <suitesparse/cholmod.h>
 #include <map>
+#include <vector>
+#include <string>
+#include "Pool.h"
 
 // Object-oriented wrapper for CHOLMOD sparse matrix format.
 
@@ -60,8 +63,30 @@ namespace cm
          operator cholmod_common*( void );
          // allows cm::Common to be treated as a cholmod_common*
 
+         static void setDefaultThreads( int n );
+         // sets the number of threads used by CHOLMOD (in every environment
+         // not limited by limitThreads()), by OpenMP loops and by the BLAS
+         // (if it is multithreaded OpenBLAS or BLIS) in factorizations and
+         // solves; n <= 0 restores the default.  Unless this is called
+         // first, the initial value is taken from the environment variable
+         // SPINXFORM_THREADS.  Environments created before the call use the
+         // new value as well
+
+         void limitThreads( int n );
+         // limits CHOLMOD to at most n threads in this environment only,
+         // without changing the default of other environments, OpenMP or
+         // the BLAS; n <= 0 follows the default again (no effect before
+         // CHOLMOD 4)
+
+         static int threads( void );
+         // returns the number of threads set by setDefaultThreads(), or the
+         // OpenMP default if none was set (at least one)
+
       protected:
          cholmod_common common;
+
+         int nThreads;
+         // limit set by limitThreads(), or 0 to follow the default
    };
 
    class Dense
@@ -71,6 +96,11 @@ namespace cm
          // initialize an mxn matrix of doubles
          // xtype is either CHOLMOD_REAL or CHOLMOD_ZOMPLEX
          
+         Dense( Common& common, double* x, int m, int n = 1 );
+         // wraps existing storage x of an mxn real matrix (in column-major
+         // order) without copying it; the storage is not freed by Dense and
+         // must outlive it
+
          Dense( const Dense& A );
          // copy constructor
          
@@ -81,7 +111,7 @@ namespace cm
          // dereference operator gets pointer to underlying cholmod_dense data structure
 
          const Dense& operator=( const Dense& A );
-         // copies A
+         // copies A (into newly allocated storage)
 
          const Dense& operator=( cholmod_dense* A );
          // gets pointer to A; will deallocate A upon destruction
@@ -140,6 +170,13 @@ namespace cm
          cholmod_dense* data;
          double* rData;
          double* iData;
+
+         cholmod_dense header;
+         // describes external storage (see above); data points to header
+         // if and only if this matrix does not own its storage
+
+         void release( void );
+         // frees the current matrix if it is owned
    };
 
    class Sparse
@@ -189,7 +226,8 @@ namespace cm
          
          typedef std::pair<int,int> EntryIndex; // NOTE: column THEN row! (makes it easier to build compressed format)
          typedef std::pair<double,double> EntryValue;
-         typedef std::map<EntryIndex,EntryValue> EntryMap;
+         typedef std::map< EntryIndex, EntryValue, std::less<EntryIndex>,
+                           PoolAllocator< std::pair<const EntryIndex,EntryValue> > > EntryMap;
          typedef EntryMap::iterator       iterator;
          typedef EntryMap::const_iterator const_iterator;
 
@@ -198,11 +236,21 @@ namespace cm
                iterator   end( void );
          const_iterator   end( void ) const;
 
+         size_t peakMemory( void ) const;
+         // returns the largest number of bytes ever used to store the
+         // entries of this matrix (entries are kept in a pool owned by
+         // the matrix, which is reused after resize())
+
       protected:
+         Sparse( const Sparse& A );
+         const Sparse& operator=( const Sparse& A );
+         // matrices own their pool of entries and cannot be copied
+
          Common& common;
          int m, n;
          int xtype, stype;
          cholmod_sparse* A;
+         Pool pool;
          EntryMap data;
 
          double& retrieveEntry( int row, int col, int c );
@@ -223,15 +271,126 @@ namespace cm
          Factor( Common& common );
          ~Factor( void );
 
+         enum Ordering
+         {
+            orderDefault, // CHOLMOD default (AMD, possibly also METIS)
+            orderNatural, // no permutation
+            orderAMD,     // approximate minimum degree
+            orderMETIS,   // METIS nested dissection
+            orderNESDIS,  // CHOLMOD nested dissection (based on METIS)
+            orderCAMD,    // constrained minimum degree (see setConstraints())
+            orderGiven    // user-supplied permutation (see setPermutation())
+         };
+
+         enum Mode
+         {
+            modeAuto,       // chosen by CHOLMOD based on the flop count
+            modeSimplicial, // column-by-column (LDL') factorization
+            modeSupernodal  // supernodal (BLAS-based LL') factorization
+         };
+
+         void setOrdering( Ordering ordering, Mode mode = modeAuto );
+         // selects the fill-reducing ordering and factorization mode used
+         // by subsequent calls to build(); METIS-based orderings fall back
+         // to AMD if CHOLMOD was built without METIS
+
+         void setConstraints( const std::vector<SuiteSparse_long>& constraints );
+         // assigns each row to a constraint set for orderCAMD -- rows in
+         // set 0 are ordered first, then rows in set 1, and so on
+
+         void setPermutation( const std::vector<SuiteSparse_long>& permutation );
+         // sets the permutation used with orderGiven, where row
+         // permutation[k] of A becomes the kth row of the factor
+
          void build( Upper& A );
          // factorizes positive-definite matrix A using CHOLMOD
 
+         void build( Upper& A, const std::string& key );
+         // factorizes A as above, but shares the symbolic analysis (fill-
+         // reducing ordering and nonzero pattern of the factor) between all
+         // factors in this process that are built with the same key, the
+         // same ordering settings, and a matrix with the same nonzero
+         // pattern: only the first such factor is analyzed, and all others
+         // are just factored numerically.  The key should identify what the
+         // pattern depends on (e.g., a hash of the connectivity of a mesh);
+         // the most recently used analyses are kept (see maxSharedAnalyses)
+
+         bool sharedAnalysis( void ) const;
+         // returns whether the most recent call to build() reused an
+         // analysis of another factor
+
+         static const int maxSharedAnalyses = 16;
+         // number of analyses kept for sharing
+
+         double nnz( void ) const;
+         // returns the number of nonzeros in the factor, as reported
+         // by the symbolic analysis in the most recent call to build()
+
+         double flops( void ) const;
+         // returns the number of floating-point operations needed to
+         // compute the factor, as reported by the most recent analysis
+
+         double rcond( void );
+         // returns an estimate of the reciprocal condition number of the
+         // factored matrix (zero if no factorization is available)
+
+         bool succeeded( void );
+         // returns whether the most recent call to build() or refactor()
+         // succeeded, i.e., CHOLMOD reported no error and the matrix was
+         // positive-definite (false if no factorization is available)
+
+         void refactor( Upper& A );
+         // numerically refactorizes A, reusing the symbolic analysis (fill-
+         // reducing ordering and nonzero pattern) from the previous call to
+         // build(); A must have the same nonzero pattern as before.  If
+         // updown() turned a supernodal factor into a simplicial one, the
+         // supernodal analysis is restored, so that the factor does not
+         // stay simplicial after the first low-rank update
+
+         bool updown( Sparse& C, bool update );
+         // modifies the factorization of A to become a factorization of
+         // A + CC' (update) or A - CC' (downdate) via a low-rank update;
+         // returns false if the result is not positive-definite, in which
+         // case the factorization must be rebuilt
+
+         void solve( Dense& x, Dense& b );
+         // solves Ax = b, writing the solution into the existing storage
+         // of x, which must have the same size as b; workspace is kept
+         // between calls, so repeated solves do not allocate memory
+
+         int size( void ) const;
+         // returns the number of rows in the factored matrix (zero if
+         // no factorization is available)
+
          cholmod_factor* operator*( void );
          // dereference operator gets pointer to underlying cholmod_factor data structure
 
       protected:
+         void analyze( cholmod_sparse* A );
+         // computes the symbolic factorization of A using the selected
+         // ordering and mode
+
+         void keepAnalysis( void );
+         // saves a copy of the symbolic factor L if it is supernodal (for
+         // refactor()), and frees any previously saved copy
+
+         std::string analysisKey( cholmod_sparse* A, const std::string& key ) const;
+         // returns the key under which the analysis of A is shared, which
+         // combines "key" with the ordering settings and the pattern of A
+
          Common& common;
          cholmod_factor *L;
+         cholmod_factor *S; // supernodal analysis (see keepAnalysis())
+         cholmod_dense *Y, *E; // workspace for solve()
+
+         Ordering ordering;
+         Mode mode;
+         std::vector<SuiteSparse_long> constraints;
+         std::vector<SuiteSparse_long> permutation;
+
+         double lnz; // nonzeros in factor
+         double fl; // flop count for factorization
+         bool shared; // whether the analysis came from another factor
    };
 }
 
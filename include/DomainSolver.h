@@ -0,0 +1,148 @@
+// =============================================================================
+// SpinXForm -- DomainSolver.h
+//
+// DomainSolver solves a sparse positive-definite system Ax = b that is too
+// large to factor as a whole, via non-overlapping domain decomposition.  Each
+// row of A is assigned to a patch; a row is on the interface if it is coupled
+// to a row of some other patch, and is interior otherwise.  Ordering interior
+// rows (I) first and interface rows (G) last, the system becomes
+//
+//    [ A_II  A_IG ] [ x_I ]   [ b_I ]
+//    [ A_GI  A_GG ] [ x_G ] = [ b_G ],
+//
+// where A_II is block-diagonal with one block per patch.  Each block is
+// factored by its own worker process, and the interface unknowns are found by
+// solving the Schur complement system
+//
+//    ( A_GG - A_GI A_II^-1 A_IG ) x_G = b_G - A_GI A_II^-1 b_I
+//
+// using Jacobi-preconditioned conjugate gradients.  The Schur complement is
+// never formed: each product with it is evaluated by all workers in parallel,
+// every worker applying only its own block.  Finally, the workers recover
+// x_I = A_II^-1 ( b_I - A_IG x_G ).
+//
+// Workers are forked from the current process by start() and communicate with
+// it over Unix-domain socket pairs (see Socket.h), so no single process ever
+// holds more than one patch factorization (plus the interface, in the case of
+// the calling process).  For example,
+//
+//    DomainSolver solver;
+//    solver.start( 8 );
+//    solver.build( A, patch );  // patch[i] is the patch of row i
+//    solver.solve( x, b );
+//
+
+#ifndef SPINXFORM_DOMAIN_SOLVER_H
+#define SPINXFORM_DOMAIN_SOLVER_H
+
+#include <vector>
+#include <sys/types.h>
+#include "CMWrapper.h"
+#include "Socket.h"
+
+using namespace cm;
+using namespace std;
+
+class DomainSolver
+{
+   public:
+      DomainSolver( void );
+      // creates a solver without any workers
+
+      ~DomainSolver( void );
+      // stops all workers
+
+      void start( int nPatches );
+      // forks one worker process for each of the patches 0, ..., nPatches-1;
+      // any previous workers are stopped first, and Error is thrown if a
+      // worker cannot be created.  Since each worker keeps a copy-on-write
+      // snapshot of the memory of this process, workers should be started
+      // before large matrices are assembled
+
+      void stop( void );
+      // stops all workers
+
+      void build( Upper& A, const vector<int>& patch );
+      // splits positive-definite matrix A into interior, coupling and
+      // interface blocks, where patch[i] is the patch of row i, and has
+      // each worker factor its interior block; Error is thrown if a
+      // worker fails
+
+      void solve( Dense& x, Dense& b );
+      // solves Ax = b, writing the solution into the existing storage of
+      // x (same interface as Factor::solve()); Error is thrown if a
+      // worker fails
+
+      int size( void ) const;
+      // returns the number of rows of A (zero if nothing was built)
+
+      int nPatches( void ) const;
+      // returns the number of patches (zero if no workers are running)
+
+      int interfaceSize( void ) const;
+      // returns the number of rows on the interface
+
+      double nnz( void ) const;
+      // returns the total number of nonzeros in the factors of all
+      // interior blocks
+
+      double tolerance;
+      // relative residual at which the interface iteration stops
+      // (1e-10 by default)
+
+      int maxIterations;
+      // maximum number of interface iterations per solve (1000 by default)
+
+      int nIterations;
+      double residual;
+      // number of interface iterations and relative interface residual
+      // of the last solve
+
+   protected:
+      DomainSolver( const DomainSolver& solver );
+      const DomainSolver& operator=( const DomainSolver& solver );
+      // solvers own their worker processes and cannot be copied
+
+      static void work( Socket& master );
+      // processes commands from the master process until it hangs up
+      // (called in each worker process)
+
+      void broadcast( const char* command, const vector< vector<double> >& data );
+      // sends a command followed by one block of data to every worker
+
+      void gather( vector< vector<double> >& data );
+      // receives one block of data from every worker, in reply to the
+      // previous broadcast
+
+      void applySchur( const vector<double>& v, vector<double>& w );
+      // computes w = Sv, where S is the Schur complement of the interface
+
+      vector<Socket*> workers;
+      vector<pid_t> pids;
+      // connections to the worker processes and their process IDs
+
+      int n;
+      // number of rows of A
+
+      vector<int> interface;
+      // rows on the interface
+
+      vector< vector<int> > interior;
+      // interior rows of each patch
+
+      vector< vector<int> > coupled;
+      // interface rows (as indices into "interface") coupled to the
+      // interior of each patch
+
+      vector<int> ggRow, ggCol;
+      vector<double> ggValue;
+      // upper triangle of A_GG (indices into "interface")
+
+      vector<double> ggDiagonal;
+      // diagonal of A_GG (used as the preconditioner)
+
+      double lnz;
+      // total nonzeros in the factors of the interior blocks
+};
+
+#endif
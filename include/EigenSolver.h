@@ -29,6 +29,17 @@
 // and applying the same inverse iteration scheme to the shifted
 // matrix B = A-c0*I.
 //
+// Alternatively, the eigenvector can be found without factoring A at all,
+// using the locally optimal block preconditioned conjugate gradient method
+// (LOBPCG, with a block size of one).  Each iteration minimizes the Rayleigh
+// quotient x'Ax/x'x over the span of the current estimate x, the
+// preconditioned residual w = T(Ax-cx), and the previous search direction.
+// A is applied only through sparse matrix-vector products with a BlockMatrix,
+// and T is the (block-)Jacobi preconditioner, i.e., the inverse of the
+// diagonal of A, so memory stays linear in the size of A.  LOBPCG needs
+// more iterations than inverse iteration, but each iteration is far cheaper
+// than a factorization.
+//
 
 #ifndef SPINXFORM_EIGENSOLVER_H
 #define SPINXFORM_EIGENSOLVER_H
@@ -36,6 +47,8 @@
 #include <vector>
 #include "QuaternionMatrix.h"
 #include "CMWrapper.h"
+#include "DomainSolver.h"
+#include "BlockMatrix.h"
 
 using namespace cm;
 using namespace std;
@@ -44,13 +57,45 @@ class EigenSolver
 {
    public:
       static void solve( Factor& A,
-                         vector<Quaternion>& x );
+                         vector<Quaternion>& x,
+                         bool warmStart = false );
       // solves the eigenvalue problem Ax = cx for the
-      // eigenvector x with the smallest eigenvalue c
+      // eigenvector x with the smallest eigenvalue c; if
+      // "warmStart" is true and x is nonzero, x is used
+      // as the initial guess
+
+      static void solve( DomainSolver& A,
+                         vector<Quaternion>& x,
+                         bool warmStart = false );
+      // same as above, using a domain-decomposed solver
+
+      static int solve( const BlockMatrix& A,
+                        vector<Quaternion>& x,
+                        bool warmStart = false,
+                        double tolerance = 1e-4,
+                        int maxIterations = 1000 );
+      // solves the eigenvalue problem using LOBPCG, stopping once the
+      // residual satisfies |Ax-cx| <= tolerance*|Ax| or after at most
+      // "maxIterations" iterations; returns the number of iterations
 
    protected:
+      template <class Solver>
+      static void inverseIteration( Solver& A,
+                                    vector<Quaternion>& x,
+                                    bool warmStart );
+      // solves the eigenvalue problem using any solver with the
+      // interface of Factor (see LinearSolver)
+
       static void normalize( vector<Quaternion>& x );
       // rescales x to have unit length
+
+      static double norm2( const vector<Quaternion>& x );
+      // returns the squared length of x
+
+      static double dot( const vector<Quaternion>& x,
+                         const vector<Quaternion>& y );
+      // returns the real inner product of x and y (i.e., the inner
+      // product of their real representations)
 };
 
 #endif
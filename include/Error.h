@@ -0,0 +1,25 @@
+// =============================================================================
+// SpinXForm -- Error.h
+//
+// Error is the exception thrown by SpinXForm when an input cannot be used
+// (a file that cannot be opened, a malformed image, invalid face indices,
+// and so on).  Library code never terminates the process; command-line
+// tools catch Error, print its message, and exit.
+//
+
+#ifndef SPINXFORM_ERROR_H
+#define SPINXFORM_ERROR_H
+
+#include <stdexcept>
+#include <string>
+
+class Error : public std::runtime_error
+{
+   public:
+      explicit Error( const std::string& message )
+      // creates an error with the specified message
+      : std::runtime_error( message )
+      {}
+};
+
+#endif
@@ -0,0 +1,65 @@
+// =============================================================================
+// SpinXForm -- FileWatcher.h
+//
+// FileWatcher reports changes to a single file without blocking, so that it
+// can be polled from an event loop.  On Linux it uses inotify on the file's
+// directory, which also catches editors and image tools that save by writing
+// a new file and renaming it over the old one; elsewhere it falls back to
+// comparing modification times.  For example,
+//
+//    FileWatcher watcher;
+//    watcher.watch( "bumpy.tga" );
+//    ...
+//    if( watcher.changed() ) reload();
+//
+// A single save often produces several events, so callers will usually want
+// to wait until the file has been quiet for a moment before reacting.
+//
+
+#ifndef SPINXFORM_FILEWATCHER_H
+#define SPINXFORM_FILEWATCHER_H
+
+#include <string>
+#include <ctime>
+
+using namespace std;
+
+class FileWatcher
+{
+   public:
+      FileWatcher( void );
+      // creates a watcher that is not watching any file
+
+      ~FileWatcher( void );
+      // stops watching
+
+      bool watch( const string& filename );
+      // starts watching the specified file (replacing any previous one);
+      // returns false if the file cannot be watched
+
+      bool changed( void );
+      // returns true if the file has been modified or replaced since the
+      // last call (or since watch() was called); never blocks
+
+   protected:
+      FileWatcher( const FileWatcher& watcher );
+      const FileWatcher& operator=( const FileWatcher& watcher );
+      // watchers own a file descriptor and cannot be copied
+
+      void close( void );
+      // stops watching
+
+      string filename;
+      // path of the watched file
+
+      string name;
+      // name of the watched file within its directory
+
+      int fd;
+      // inotify descriptor (or -1)
+
+      time_t modified;
+      // modification time of the file (used without inotify)
+};
+
+#endif
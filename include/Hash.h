@@ -0,0 +1,66 @@
+// =============================================================================
+// SpinXForm -- Hash.h
+//
+// Hash computes a 64-bit FNV-1a hash of a stream of bytes, for use as a key
+// into caches.  Data is added incrementally, and the hash can be read at any
+// time, either as a number or as 16 hexadecimal digits (e.g., for use as a
+// file name):
+//
+//    Hash hash;
+//    hash.add( &positions[0], positions.size()*sizeof(double) );
+//    hash.add( nVertices );
+//    string key = hash.hex();
+//
+// Values are hashed via their in-memory representation, so hashes are only
+// comparable between machines with the same byte order and type sizes.
+//
+
+#ifndef SPINXFORM_HASH_H
+#define SPINXFORM_HASH_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+class Hash
+{
+   public:
+      Hash( void );
+      // creates the hash of an empty stream
+
+      explicit Hash( uint64_t seed );
+      // creates the hash of an empty stream, starting from a different
+      // state for each seed, so that hashes of the same stream with
+      // different seeds can serve as independent checks of each other
+
+      void add( const void* data, size_t size );
+      // appends "size" bytes to the stream
+
+      template <class T>
+      void add( const T& value )
+      // appends the bytes of a single value
+      {
+         add( &value, sizeof(T) );
+      }
+
+      template <class T>
+      void add( const std::vector<T>& values )
+      // appends the size of a vector, followed by the bytes of its elements
+      {
+         add( values.size() );
+         if( !values.empty() ) add( &values[0], values.size()*sizeof(T) );
+      }
+
+      uint64_t value( void ) const;
+      // returns the hash of all bytes added so far
+
+      std::string hex( void ) const;
+      // returns the hash as 16 hexadecimal digits
+
+   protected:
+      uint64_t h;
+      // current state
+};
+
+#endif
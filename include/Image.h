@@ -3,8 +3,12 @@
 // Keenan Crane
 // August 16, 2011
 //
-// Image represents a grayscale bitmapped image.  Standard usage might
-// look something like
+// Image represents a grayscale bitmapped image.  Images can be loaded from
+// 8-bit Truevision TGA files, 8- or 16-bit binary PGM files, or 32-bit
+// floating-point PFM files; the format is determined from the file contents.
+// Pixels are kept at their native width (8-bit, 16-bit, or float) and stored
+// in 8x8 tiles, so that neighboring lookups mostly hit the same cache lines.
+// Standard usage might look something like
 //
 //    Image im;
 //    im.load( "image.tga" );
@@ -13,44 +17,116 @@
 //    double p[2] = { .5, 1.23 };
 //    double value = im.sample( p[0], p[1] );
 //
+// Many points can be sampled at once by passing arrays of coordinates to
+// sample(), which is considerably faster than sampling one point at a time.
+// To avoid aliasing when a single value must represent a large region of the
+// image, sampleFiltered() uses mip-mapping and average() approximately
+// integrates the image over a triangle.
+//
 
 #ifndef SPINXFORM_IMAGE_H
 #define SPINXFORM_IMAGE_H
 
 #include <vector>
 #include <string>
+#include <istream>
 
 using namespace std;
 
 class Image
 {
    public:
-            double& operator()( int x, int y );
-      const double& operator()( int x, int y ) const;
-      // accesses double (x,y)
+      Image( void );
+      // creates an empty image
+
+      double operator()( int x, int y ) const;
+      // returns the value of pixel (x,y) in the range [0,1]
 
       double sample( double x, double y ) const;
       // samples image at (x,y) using bilinear filtering
 
+      void sample( int n, const double* x, const double* y, double* values ) const;
+      // samples image at n points (x[i],y[i]) using bilinear filtering
+
+      double sampleFiltered( double x, double y, double footprint ) const;
+      // samples image at (x,y) using trilinear mip-map filtering, i.e.,
+      // averages over a square region roughly "footprint" pixels wide;
+      // requires a previous call to buildMipmaps()
+
+      double average( const double x[3], const double y[3] ) const;
+      // approximates the average value of the (bilinearly interpolated)
+      // image over the triangle with corners (x[i],y[i]) by sampling it at
+      // up to about two points per pixel covered
+
+      void buildMipmaps( void ) const;
+      // builds the mip-map pyramid used by sampleFiltered(), unless it
+      // has already been built
+
       int  width( void ) const;
       int height( void ) const;
       // returns image dimensions
 
       void read( const char* filename );
-      // loads an image file in Truevision TGA format
-      // (must be uncompressed RGB image with 24 or 32 bits per double)
+      // loads an image file in Truevision TGA, PGM, or PFM format
+      // (must be a single-channel grayscale image); throws Error if
+      // the file cannot be read
 
       void reload( void );
       // updates image from disk
 
+      const string& source( void ) const;
+      // returns the name of the file the image was read from
+
    protected:
+      enum PixelType
+      {
+         pixel8,
+         pixel16,
+         pixelFloat
+      };
+
+      void allocate( int width, int height, PixelType type, double normalization );
+      // allocates (zeroed) tiled storage for a width x height image
+
+      int index( int x, int y ) const;
+      // returns the position of pixel (x,y) in tiled storage
+
+      template <class T>
+      T* pixelData( void );
+      template <class T>
+      const T* pixelData( void ) const;
+      // returns storage as an array of the native pixel type
+
+      template <class T>
+      void sampleBatch( int n, const double* x, const double* y, double* values ) const;
+      // samples n points using the native pixel type T
+
+      double sampleLevel( int level, double x, double y ) const;
+      // samples mip-map level "level" at (x,y) using bilinear filtering,
+      // where (x,y) is given in pixel coordinates of the full image
+
+      void readTGA( istream& in );
+      // loads an uncompressed 8-bit grayscale TGA image
+
+      void readPGM( istream& in );
+      // loads a binary (P5) PGM image with 8 or 16 bits per pixel
+
+      void readPFM( istream& in );
+      // loads a grayscale (Pf) PFM image with 32-bit float pixels
+
       void clamp( int& x, int& y ) const;
       // clamps coordinates to range [0,w-1] x [0,h-1]
 
       string filename; // name of source file
-      vector<double> pixels; // interleaved RGBA double data in range [0-1]
+      vector<unsigned char> data; // pixel data at native width, in 8x8 tiles
+      PixelType type; // native pixel type
+      double normalization; // maps stored values to the range [0,1]
       int w; // width
       int h; // height
+      int tilesX; // number of tiles per row
+
+      mutable vector< vector<float> > mipmaps; // mip-map levels 1, 2, ... (row-major)
+      mutable vector<int> mipWidth, mipHeight; // dimensions of each mip-map level
 };
 
 #endif
@@ -28,6 +28,7 @@
 #include <vector>
 #include "QuaternionMatrix.h"
 #include "CMWrapper.h"
+#include "DomainSolver.h"
 
 using namespace cm;
 using namespace std;
@@ -38,15 +39,21 @@ class LinearSolver
       static void solve( Factor& A,
                          vector<Quaternion>& x,
                          const vector<Quaternion>& b );
-      // solves the linear system Ax = b where A is positive-semidefinite
+      // solves the linear system Ax = b where A is positive-semidefinite;
+      // if A has 4n rows, only the first n entries of b are used and x is
+      // resized to n entries.  No copies are made: the storage of x and b
+      // is handed directly to CHOLMOD (x and b must not be the same vector)
 
-      static void toReal( const vector<Quaternion>& uQuat,
-                          Dense& uReal );
-      // converts vector from quaternion- to real-valued entries
+      static void solve( DomainSolver& A,
+                         vector<Quaternion>& x,
+                         const vector<Quaternion>& b );
+      // same as above, using a domain-decomposed solver
 
-      static void toQuat( const Dense& uReal,
-                          vector<Quaternion>& uQuat );
-      // converts vector from real- to quaternion-valued entries
+      static double* toReal( vector<Quaternion>& u );
+      static const double* toReal( const vector<Quaternion>& u );
+      // returns the entries of u as a real vector of 4*u.size() values
+      // (real part, then i, j and k for each entry); this is simply the
+      // storage of u, not a copy
 };
 
 #endif
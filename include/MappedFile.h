@@ -0,0 +1,54 @@
+// =============================================================================
+// SpinXForm -- MappedFile.h
+//
+// MappedFile maps the contents of a file into memory (read-only), so that
+// large binary arrays can be used directly without reading, parsing, or
+// converting them.  The mapping stays valid until the object is closed or
+// destroyed.  For instance,
+//
+//    MappedFile file;
+//    if( file.open( "rho.bin" ))
+//    {
+//       const double* values = (const double*) file.data();
+//       size_t n = file.size() / sizeof(double);
+//    }
+//
+
+#ifndef SPINXFORM_MAPPEDFILE_H
+#define SPINXFORM_MAPPEDFILE_H
+
+#include <string>
+
+using namespace std;
+
+class MappedFile
+{
+   public:
+      MappedFile( void );
+      // creates an empty mapping
+
+      ~MappedFile( void );
+      // releases the mapping, if any
+
+      bool open( const string& filename );
+      // maps the specified file into memory; returns false on failure
+
+      void close( void );
+      // releases the mapping
+
+      const void* data( void ) const;
+      // returns a pointer to the first byte of the file
+
+      size_t size( void ) const;
+      // returns the size of the file in bytes
+
+   protected:
+      MappedFile( const MappedFile& f );
+      const MappedFile& operator=( const MappedFile& f );
+      // mappings cannot be copied
+
+      void* address; // start of the mapping
+      size_t length; // length of the mapping in bytes
+};
+
+#endif
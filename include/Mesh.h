@@ -11,7 +11,19 @@
 // To specify a deformation, the user should set a value of "rho" on each
 // face corresponding to the desired change in curvature.  The deformation
 // is computed by calling updateDeformation(), which puts the transformed
-// vertices in the list "newVertices."
+// vertex coordinates in the contiguous array "newPositions."
+//
+// If the mesh has several connected components, each component is deformed
+// as an independent subproblem (with its own, smaller factorizations), and
+// the components are solved in parallel.  Since each component is only
+// determined up to translation and scale, its deformed copy keeps the
+// original centroid and surface area of that component before the whole
+// surface is normalized.
+//
+// Meshes too large for a single factorization can instead be split into
+// patches (see setDomainDecomposition()), whose interiors are factored by
+// separate worker processes; the unknowns on the interfaces between patches
+// are then found iteratively (see DomainSolver.h).
 //
 
 #ifndef SPINXFORM_MESH_H
@@ -23,6 +35,11 @@
 #include "QuaternionMatrix.h"
 #include "Image.h"
 #include "CMWrapper.h"
+#include "DomainSolver.h"
+#include "BlockMatrix.h"
+#include "ResultCache.h"
+#include "Hash.h"
+#include "Error.h"
 
 using namespace cm;
 using namespace std;
@@ -34,44 +51,259 @@ class Face
       Vector uv[3]; // texture coordinates (for visualization only)
 };
 
+class Edge
+{
+   public:
+      int vertex[2]; // indices of endpoints (in increasing order)
+      int face[2]; // indices of adjacent triangles (-1 if none)
+      double weight; // cotangent weight (cot(alpha)+cot(beta))/2
+};
+
 class Mesh
 {
    public:
       Mesh( void );
       // default constructor
 
-      void read( const string& filename );
-      // loads a triangle mesh in Wavefront OBJ format
+      ~Mesh( void );
+      // destructor
+
+      enum VertexOrdering
+      {
+         orderOriginal, // keep the order of the file
+         orderRCM,      // reverse Cuthill-McKee (reduces bandwidth)
+         orderMorton    // Morton (Z-order) curve through vertex positions
+      };
+
+      void read( const string& filename, VertexOrdering ordering = orderOriginal );
+      // loads a triangle mesh in Wavefront OBJ format; vertices are
+      // renumbered according to "ordering," and faces are sorted by
+      // their vertices so that neighboring faces are close in memory;
+      // throws Error if the file cannot be read or is malformed
+
+      void build( const double* positions, int nVertices,
+                  const int* indices, int nFaces,
+                  VertexOrdering ordering = orderOriginal );
+      // builds a triangle mesh from in-memory arrays, where "positions"
+      // contains 3*nVertices coordinates (x,y,z for each vertex) and
+      // "indices" contains 3*nFaces zero-based vertex indices; vertices
+      // are reordered as in read(), and Error is thrown if an index is
+      // out of range
 
-      void write( const string& filename );
-      // saves a triangle mesh in Wavefront OBJ format
+      void getPositions( double* positions, bool originalOrder = true ) const;
+      void getPositions( float* positions, bool originalOrder = true ) const;
+      // copies the 3*nVertices coordinates of the deformed vertices into
+      // a caller-provided array, in the vertex order of the input unless
+      // "originalOrder" is false (in which case the values of
+      // "newPositions" can also be used directly, without a copy)
 
-      void setCurvatureChange( const Image& image, const double scale );
+      void write( const string& filename, bool originalOrder = true );
+      // saves a triangle mesh in Wavefront OBJ format, using the vertex
+      // and face order of the original file unless "originalOrder" is
+      // false; throws Error if the file cannot be written
+
+      void write( const string& filename, const vector<double>& positions,
+                  bool originalOrder = true ) const;
+      // saves the mesh as above, but with the specified vertex positions
+      // (3*nVertices coordinates, in the same order as "newPositions")
+      // instead of the current deformation; since only the connectivity
+      // of the mesh is read, this may be called while another thread
+      // runs updateDeformation()
+
+      enum CurvatureSampling
+      {
+         sampleCorners, // average of point samples at the three corners
+         sampleMipmap,  // mip-mapped sample at the centroid
+         sampleArea     // integral of the image over the whole triangle
+      };
+
+      void setCurvatureChange( const Image& image, const double scale,
+                               CurvatureSampling sampling = sampleCorners );
       // sets rho values by interpreting "image" as a square image
       // in the range [0,1] x [0,1] and mapping values to the
       // surface via vertex texture coordinates -- grayscale
       // values in the  range [0,1] get mapped (linearly) to values
-      // in the range [-scale,scale]
+      // in the range [-scale,scale]; "sampling" determines how the
+      // image is averaged over each face
+
+      void setCurvatureChange( const double* values, const double scale = 1. );
+      void setCurvatureChange( const float* values, const double scale = 1. );
+      // sets rho values directly from an array containing one value
+      // per face (in the face order of the original file), multiplied
+      // by "scale"
+
+      bool readCurvatureChange( const string& filename, const double scale = 1. );
+      // sets rho values from a raw binary file containing one double or
+      // one float per face (determined by the file size), multiplied by
+      // "scale"; the file is memory-mapped rather than parsed, and false
+      // is returned if it cannot be read or has the wrong size
+
+      void setFactorOrdering( Factor::Ordering ordering,
+                              Factor::Mode mode = Factor::modeAuto );
+      // selects the fill-reducing ordering and factorization mode for the
+      // Laplace and eigenvalue matrices; must be called before read() to
+      // affect the Laplacian -- with Factor::orderCAMD, boundary vertices
+      // are ordered last
+
+      enum PoissonConstraint
+      {
+         constrainPin,     // fix the final vertex at the origin
+         constrainShift,   // shift the diagonal slightly and refine iteratively
+         constrainMeanZero // require vertex positions to have zero mean (the
+                           // bordered system [L 1; 1' 0], solved via the
+                           // pinned factor and its Schur complement)
+      };
+
+      void setPoissonConstraint( PoissonConstraint constraint );
+      // selects how the translational degree of freedom of the Poisson
+      // problem for vertex positions is removed (rebuilding the Laplacian
+      // if a mesh has already been loaded)
+
+      enum Eigensolver
+      {
+         eigensolveInverse, // inverse iteration with a Cholesky factorization
+         eigensolveLOBPCG   // factorization-free LOBPCG (see EigenSolver.h)
+      };
+
+      void setEigensolver( Eigensolver method );
+      // selects how the eigenvalue problem is solved; with LOBPCG the
+      // eigenvalue matrix is never factored, and memory stays linear in
+      // the size of the mesh.  Should be called before read(), since no
+      // domain decomposition is set up for a matrix that is not factored
+
+      void setDomainDecomposition( int nPatches );
+      // solves the Laplace and eigenvalue problems by splitting the mesh
+      // into nPatches patches of roughly equal size, each factored by a
+      // separate worker process, rather than factoring the full matrices;
+      // must be called before read(), and nPatches <= 1 disables domain
+      // decomposition (the default).  Connected components are split
+      // into patches in proportion to their size
+
+      void setResultCache( ResultCache* cache );
+      // looks up the result of updateDeformation() in "cache" (or in no
+      // cache, if NULL) before solving, and stores every newly computed
+      // result there; results are keyed by a hash of the geometry and
+      // connectivity of the mesh, rho (which includes the curvature
+      // scale), and the solver settings.  The cache is bypassed while
+      // warm starting, since the result then also depends on the previous
+      // solution.  The cache must outlive its use by this mesh
+
+      void printFactorStatistics( void );
+      // prints the number of nonzeros, the flop count, and the estimated
+      // reciprocal condition number of each factor, the peak memory used
+      // to assemble each matrix, the residual of the last eigensolve, as
+      // well as the number of iterations and the residual of the last
+      // Poisson solve
 
       void updateDeformation( void );
       // computes a conformal deformation using the current rho
 
+      double poissonConditionNumber( int nIterations = 100 );
+      // estimates the condition number of the operator inverted by the
+      // Poisson solve (the pinned Laplacian, the shifted Laplacian, or the
+      // Laplacian on vectors with zero mean) via power and inverse
+      // iteration, each taking nIterations steps; for a mesh with several
+      // components, the largest estimate over all components is returned
+
+      int nComponents( void ) const;
+      // returns the number of connected components of the mesh
+
+      bool verbose;
+      // whether updateDeformation() prints its timings (true by default)
+
+      bool warmStart;
+      // whether each eigensolve starts from the previous solution rather
+      // than from the identity (false by default); when rho changes
+      // gradually, e.g., between frames of an animation, LOBPCG then needs
+      // fewer iterations, while inverse iteration (which always performs
+      // the same fixed number of iterations) returns a more accurate
+      // solution at the same cost
+
+      bool (*cancelled)( void );
+      // if not NULL, called by updateDeformation() after the eigenvalue
+      // problem is solved; if it returns true, the Poisson problem is
+      // skipped and "newPositions" keeps the previous deformation (once
+      // it has returned true, it must keep doing so until
+      // updateDeformation() returns)
+
+      double factorTime, eigensolveTime, poissonTime;
+      // wall-clock times in seconds of the stages of the last call to
+      // updateDeformation() (summed over connected components)
+
       void resetDeformation( void );
       // restores surface to its original configuration
 
-      double area( int i );
+      Vector newVertex( int i ) const;
+      // returns the deformed position of vertex i
+
+      double area( int i ) const;
       // returns area of triangle i in the original mesh
 
+      double cotan( int i, int j ) const;
+      // returns cotangent of the angle at corner j of triangle i
+      // in the original mesh
+
+      const Quaternion& edgeVector( int i, int j ) const;
+      // returns the edge vector of triangle i across from corner j
+      // in the original mesh (as an imaginary quaternion)
+
+      int nNeighbors( int i ) const;
+      // returns the number of vertices adjacent to vertex i
+
+      int neighbor( int i, int k ) const;
+      // returns the kth vertex adjacent to vertex i
+
+      int neighborEdge( int i, int k ) const;
+      // returns the index of the edge between vertex i and its
+      // kth neighbor
+
+      bool isBoundary( int i ) const;
+      // returns true if vertex i is on the boundary
+
       vector<Face> faces;
       // list of triangles as indices into vertex list
 
-      vector<Quaternion> vertices, newVertices;
-      // original and deformed vertex coordinates
+      vector<Edge> edges;
+      // list of unique edges, sorted by vertex indices
+
+      vector<Quaternion> vertices;
+      // original vertex coordinates
+
+      vector<double> newPositions;
+      // deformed vertex coordinates, stored contiguously as x, y, z
+      // for each vertex
 
       vector<double> rho;
       // controls change in curvature (one value per face)
 
    protected:
+      Mesh( const Mesh& mesh );
+      const Mesh& operator=( const Mesh& mesh );
+      // meshes own their factorizations and cannot be copied
+
+      vector<double> faceAreas;
+      // area of each triangle in the original mesh
+
+      vector<double> cotangents;
+      // cotangent of the angle at each triangle corner (three per
+      // face, in the same order as Face::vertex)
+
+      vector<Quaternion> edgeVectors;
+      // edge vector across from each triangle corner (three per face)
+
+      vector<int> originalVertex, originalFace;
+      // index of each vertex and each face in the original file
+
+      vector<int> adjacencyStart;
+      // offset of the first neighbor of each vertex in "adjacency" (one
+      // value per vertex, plus one final value)
+
+      vector<int> adjacency, adjacentEdges;
+      // neighbors of all vertices and the corresponding edges, stored
+      // contiguously (compressed sparse rows)
+
+      vector<bool> boundaryVertices;
+      // whether each vertex lies on the boundary
 
       vector<Quaternion> lambda;
       // local similarity transformation (one value per vertex)
@@ -79,11 +311,118 @@ class Mesh
       vector<Quaternion> omega;
       // divergence of target edge vectors
 
+      vector<Quaternion> poissonSolution;
+      // quaternion-valued solution of the Poisson problem (kept between
+      // solves so that its storage can be reused)
+
+      vector<double> borderColumn, borderW[2];
+      double borderInverse[2][2];
+      // for the mean-zero constraint: the final column l of L (without its
+      // diagonal), the solutions of L_p w = l and L_p w = 1 for the pinned
+      // Laplacian L_p, and the inverse of the 2x2 Schur complement of the
+      // bordered system with respect to L_p
+
+      Common common;
+      // CHOLMOD environment of this mesh (CHOLMOD calls that share an
+      // environment cannot run concurrently)
+
       Factor L; // Laplace matrix
       Factor E; // matrix for eigenvalue problem
 
+      PoissonConstraint poissonConstraint;
+      // how the Poisson problem is made positive-definite
+
+      int nPoissonIterations;
+      double poissonResidual;
+      // number of solves and relative residual of the last Poisson solve
+
+      QuaternionMatrix E0;
+      // assembled (unfactored) matrix for eigenvalue problem
+
+      string connectivityKey;
+      // hash of the number of vertices and of the faces, which determine
+      // the nonzero patterns of L and E, so that meshes with the same
+      // connectivity share symbolic factorizations (see Factor::build())
+
+      Eigensolver eigensolver;
+      // method used for the eigenvalue problem
+
+      BlockMatrix Eblock;
+      // block form of E0 (used instead of factoring E by LOBPCG)
+
+      int nEigenIterations;
+      // number of LOBPCG iterations in the last eigensolve
+
+      size_t laplacianMemory;
+      // peak memory used to assemble the Laplace matrix
+
+      vector<double> rhoFactored;
+      // values of rho used in the current factorization of E
+      // (empty if E has not been factored yet)
+
+      int nLowRankUpdates;
+      // number of low-rank updates applied to E since it was last
+      // refactored from scratch
+
+      Factor::Ordering factorOrdering;
+      Factor::Mode factorMode;
+      // settings passed to setFactorOrdering()
+
+      int nPatches;
+      // number of patches used for domain decomposition (1 if disabled)
+
+      ResultCache* resultCache;
+      // cache of deformations (NULL if not used)
+
+      string resultKey( ResultCache::Signature& signature ) const;
+      // returns the key of the current deformation in the result cache,
+      // and computes the signature stored along with it
+
+      void hashInputs( Hash& hash ) const;
+      // adds everything the deformation depends on to a hash
+
+      vector<int> vertexPatch;
+      // patch of each vertex
+
+      DomainSolver domainL, domainE;
+      // domain-decomposed solvers used in place of L and E when the mesh
+      // is split into patches (these have no workers otherwise)
+
+      vector<Mesh*> components;
+      // independent subproblems, one per connected component, sorted by
+      // decreasing size (empty if the mesh is connected)
+
+      vector< vector<int> > componentVertices, componentFaces;
+      // vertices and faces of this mesh corresponding to the vertices
+      // and faces of each component
+
+      void initialize( VertexOrdering ordering );
+      void reorder( VertexOrdering ordering );
+      void reverseCuthillMcKee( vector<int>& order ) const;
+      int peripheralVertex( int root, vector<int>& depth ) const;
+      void mortonOrder( vector<int>& order ) const;
+      void buildGeometry( void );
+      void buildConnectivity( void );
+      int findComponents( void );
+      void buildComponents( void );
+      void clearComponents( void );
+      void partitionVertices( void );
+      void rowPatches( int nVertices, vector<int>& patch ) const;
+      void computeDeformation( void );
+      void solveComponents( void );
+      void setBoundaryConstraints( Factor& A, int nVertices );
       void buildEigenvalueProblem( void );
+      void addEigenvalueTerms( int k, double a, double b, double c );
+      bool updateEigenvalueProblem( const vector<int>& changed );
+      void checkEigenvector( double& eigenvalue, double& residual ) const;
       void buildPoissonProblem( void );
+      void solvePoissonProblem( void );
+      void solveLaplacian( vector<Quaternion>& x, const vector<Quaternion>& b );
+      void solvePinned( vector<Quaternion>& x, const vector<Quaternion>& b );
+      void buildBorder( void );
+      void projectPoisson( vector<Quaternion>& x ) const;
+      void setPositions( const vector<Quaternion>& x, bool accumulate = false );
+      void applyLaplacian( const vector<double>& x, vector<double>& y ) const;
       void buildLaplacian( void );
       void buildOmega( void );
       void normalizeSolution( void );
@@ -0,0 +1,73 @@
+// =============================================================================
+// SpinXForm -- PointCache.h
+//
+// PointCache writes an animation as a sequence of vertex positions in the
+// PC2 point cache format, which can be loaded by Blender, 3ds Max, Maya and
+// Houdini (among others).  A PC2 file consists of a 32-byte header followed
+// by the xyz coordinates of every point for every frame as little-endian
+// 32-bit floats.  Frames are appended one at a time, so that a sequence of
+// any length can be streamed to disk without being kept in memory; the frame
+// count in the header is updated when the file is closed.  For example,
+//
+//    PointCache cache;
+//    cache.open( "animation.pc2", nVertices );
+//    for( ... ) cache.write( positions );
+//    cache.close();
+//
+
+#ifndef SPINXFORM_POINTCACHE_H
+#define SPINXFORM_POINTCACHE_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class PointCache
+{
+   public:
+      PointCache( void );
+      // creates a closed point cache
+
+      ~PointCache( void );
+      // closes the file, if open
+
+      void open( const string& filename, int nPoints,
+                 double startFrame = 0., double sampleRate = 1. );
+      // creates the specified file and writes the header for a cache of
+      // "nPoints" points per frame, starting at "startFrame" with one
+      // frame every "sampleRate" frames; throws Error on failure
+
+      void write( const float* positions );
+      // appends a frame containing 3*nPoints coordinates (x,y,z for each
+      // point); throws Error on failure
+
+      void close( void );
+      // records the number of frames in the header and closes the file
+
+      int nFrames( void ) const;
+      // returns the number of frames written so far
+
+   protected:
+      PointCache( const PointCache& cache );
+      const PointCache& operator=( const PointCache& cache );
+      // point caches own an open file and cannot be copied
+
+      ofstream out;
+      // output file
+
+      string filename;
+      // name of the output file (for error messages)
+
+      int nPoints;
+      // number of points per frame
+
+      int nSamples;
+      // number of frames written so far
+
+      vector<float> buffer;
+      // frame data in little-endian byte order (big-endian machines only)
+};
+
+#endif
@@ -0,0 +1,152 @@
+// =============================================================================
+// SpinXForm -- Pool.h
+//
+// Pool is a resettable arena for the many small objects created while
+// assembling sparse matrices (one std::map node per nonzero).  Storage is
+// carved out of large chunks, freed objects are kept on free lists (one per
+// size class) for reuse, and reset() makes all chunks available again at
+// once, without returning them to the system.  Repeated assemblies into the
+// same matrix therefore reuse the same memory and do not call malloc() or
+// free() at all.  PoolAllocator lets standard containers draw from a pool:
+//
+//    Pool pool;
+//    typedef map< int, double, less<int>, PoolAllocator< pair<const int,double> > > Map;
+//    Map m( less<int>(), PoolAllocator< pair<const int,double> >( &pool ));
+//
+// A pool must outlive every container using it, and is not thread-safe.
+//
+
+#ifndef SPINXFORM_POOL_H
+#define SPINXFORM_POOL_H
+
+#include <new>
+#include <vector>
+#include <cstddef>
+
+class Pool
+{
+   public:
+      Pool( size_t chunkSize = 1<<20 );
+      // creates an empty pool that reserves memory in chunks of the
+      // specified number of bytes
+
+      ~Pool( void );
+      // returns all chunks to the system
+
+      void* allocate( size_t size );
+      // returns storage for an object of the specified size (objects
+      // larger than maxObjectSize come directly from operator new)
+
+      void deallocate( void* p, size_t size );
+      // returns the storage of an object, which must have been allocated
+      // from this pool with the same size
+
+      void reset( void );
+      // makes all chunks available again and empties the free lists, so
+      // that new objects are carved out of the chunks in order; should
+      // only be called once all objects have been deallocated (e.g.,
+      // after clearing the container that uses the pool)
+
+      size_t usage( void ) const;
+      // returns the number of bytes currently allocated
+
+      size_t peakUsage( void ) const;
+      // returns the maximum number of bytes allocated at any one time
+
+      size_t capacity( void ) const;
+      // returns the number of bytes reserved in chunks
+
+      static const size_t alignment = 16;
+      // object sizes are rounded up to a multiple of this value
+
+      static const size_t maxObjectSize = 256;
+      // largest object served from chunks
+
+   protected:
+      Pool( const Pool& pool );
+      const Pool& operator=( const Pool& pool );
+      // pools own their chunks and cannot be copied
+
+      std::vector<char*> chunks;
+      // storage reserved from the system
+
+      size_t chunkSize;
+      // size of each chunk in bytes
+
+      size_t current, offset;
+      // chunk from which new objects are carved, and the first unused
+      // byte in this chunk
+
+      std::vector<void*> freeLists;
+      // first free object of each size class (each free object stores a
+      // pointer to the next one)
+
+      size_t used, peak;
+      // bytes currently allocated, and the maximum so far
+};
+
+template <class T>
+class PoolAllocator
+// standard allocator drawing from a Pool (or from operator new, if
+// no pool is given)
+{
+   public:
+      typedef T value_type;
+      typedef T* pointer;
+      typedef const T* const_pointer;
+      typedef T& reference;
+      typedef const T& const_reference;
+      typedef size_t size_type;
+      typedef ptrdiff_t difference_type;
+
+      template <class U>
+      struct rebind
+      {
+         typedef PoolAllocator<U> other;
+      };
+
+      PoolAllocator( Pool* _pool = NULL ) : pool( _pool ) {}
+
+      template <class U>
+      PoolAllocator( const PoolAllocator<U>& a ) : pool( a.pool ) {}
+
+            pointer address(       reference x ) const { return &x; }
+      const_pointer address( const_reference x ) const { return &x; }
+
+      pointer allocate( size_type n, const void* hint = NULL )
+      {
+         size_t size = n*sizeof(T);
+         return (pointer) ( pool ? pool->allocate( size ) : ::operator new( size ));
+      }
+
+      void deallocate( pointer p, size_type n )
+      {
+         if( pool ) pool->deallocate( p, n*sizeof(T) );
+         else ::operator delete( p );
+      }
+
+      size_type max_size( void ) const
+      {
+         return size_t( -1 ) / sizeof(T);
+      }
+
+      void construct( pointer p, const T& value ) { new( (void*) p ) T( value ); }
+      void destroy( pointer p ) { p->~T(); }
+
+      Pool* pool;
+      // pool providing storage (NULL for operator new)
+};
+
+template <class T, class U>
+bool operator==( const PoolAllocator<T>& a, const PoolAllocator<U>& b )
+{
+   return a.pool == b.pool;
+}
+
+template <class T, class U>
+bool operator!=( const PoolAllocator<T>& a, const PoolAllocator<U>& b )
+{
+   return a.pool != b.pool;
+}
+
+#endif
@@ -76,6 +76,8 @@ class Quaternion
 
    protected:
       // STORAGE ---------------------------------------------------------------
+      // (LinearSolver relies on this layout -- four consecutive doubles
+      // s, v.x, v.y, v.z -- to pass quaternion vectors to CHOLMOD directly)
       double s; // scalar (double) part
       Vector v; // vector (imaginary) part
 };
@@ -87,4 +89,3 @@ Quaternion operator*( double c, const Quaternion& q ); // scalar multiplication
 std::ostream& operator<<( std::ostream& os, const Quaternion& q ); // prints components
 
 #endif
-
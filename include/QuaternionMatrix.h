@@ -11,7 +11,10 @@
 // A QuaternionMatrix can be converted to a sparse matrix with real-valued
 // entries by calling toReal().  Better performance could probably be achieved
 // by building matrices directly in real, compressed-column format, but
-// currently matrix construction is not a bottleneck.
+// currently matrix construction is not a bottleneck.  Entries (of both the
+// quaternionic and the real matrix) are stored in pools owned by the matrix
+// (see Pool.h), so a matrix that is resized and assembled repeatedly reuses
+// the same memory rather than allocating every entry on the heap.
 //
 
 #ifndef SPINXFORM_QUATERNIONMATRIX_H
@@ -22,6 +25,7 @@
 #include <iostream>
 #include "Quaternion.h"
 #include "CMWrapper.h"
+#include "Pool.h"
 
 
 class QuaternionMatrix
@@ -30,6 +34,9 @@ class QuaternionMatrix
       QuaternionMatrix( void );
       // default constructor
 
+      QuaternionMatrix( cm::Common& common );
+      // constructor using the specified CHOLMOD environment for toReal()
+
       void resize( int m, int n );
       // allocates an mxn matrix of zeros
       
@@ -41,12 +48,33 @@ class QuaternionMatrix
       // access element (row,col)
       // note: uses 0-based indexing
 
-      cm::Upper& toReal( void );
-      // returns real matrix where each quaternion becomes a 4x4 block
+      cm::Upper& toReal( bool keepZeros = false );
+      // returns real matrix where each quaternion becomes a 4x4 block;
+      // if keepZeros is true, all 16 entries of every block are stored
+      // (even if zero) so that the nonzero pattern depends only on which
+      // quaternion entries are present, not on their values
+
+      size_t peakMemory( void ) const;
+      // returns the largest number of bytes ever used to store the
+      // entries of this matrix and of its real representation
 
-   protected:
       typedef std::pair<int,int> EntryIndex; // NOTE: column THEN row! (makes it easier to build compressed format)
-      typedef std::map<EntryIndex,Quaternion> EntryMap;
+      typedef std::map< EntryIndex, Quaternion, std::less<EntryIndex>,
+                        PoolAllocator< std::pair<const EntryIndex,Quaternion> > > EntryMap;
+
+      typedef EntryMap::const_iterator const_iterator;
+
+      const_iterator begin( void ) const;
+      const_iterator   end( void ) const;
+      // iterate over nonzero entries in column-major order
+
+   protected:
+      QuaternionMatrix( const QuaternionMatrix& A );
+      const QuaternionMatrix& operator=( const QuaternionMatrix& A );
+      // matrices own their pool of entries and cannot be copied
+
+      Pool pool;
+      // storage for entries
 
       EntryMap data;
       // non-zero entries
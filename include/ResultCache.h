@@ -0,0 +1,109 @@
+// =============================================================================
+// SpinXForm -- ResultCache.h
+//
+// ResultCache stores deformed vertex positions on disk, so that a
+// deformation that was already computed (possibly by another process) can be
+// returned without solving again.  Each entry is a file in the cache
+// directory, named by a key that identifies everything the result depends on
+// (see Mesh::setResultCache(), which hashes the mesh, rho and the solver
+// settings).  Since a key is only a 64-bit hash, each entry also records a
+// signature -- the size of the mesh and a second, independent hash of the
+// same inputs -- which must match for the entry to be used.  Entries are
+// written to a temporary file and then renamed, so several processes may
+// share one directory.  The total size of all entries is bounded: whenever
+// a new entry pushes it over the capacity, the least recently used entries
+// (by modification time, which is updated on every hit) are deleted.  For
+// example,
+//
+//    ResultCache cache;
+//    cache.open( "/tmp/spinxform-cache", 256<<20 );
+//    if( !cache.fetch( key, signature, positions ))
+//    {
+//       ... // compute positions
+//       cache.store( key, signature, positions );
+//    }
+//
+
+#ifndef SPINXFORM_RESULT_CACHE_H
+#define SPINXFORM_RESULT_CACHE_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+using namespace std;
+
+class ResultCache
+{
+   public:
+      class Signature
+      {
+         public:
+            Signature( void );
+            // creates an empty signature
+
+            uint64_t nVertices, nFaces;
+            // size of the mesh
+
+            uint64_t check;
+            // hash of the inputs, independent of the hash used as the key
+
+            bool operator==( const Signature& s ) const;
+            // returns whether all fields are equal
+      };
+
+      ResultCache( void );
+      // creates a cache without a directory (see open())
+
+      void open( const string& directory, size_t capacity = 1<<30 );
+      // uses the specified directory (which is created if it does not
+      // exist yet), keeping at most "capacity" bytes of entries; throws
+      // Error if the directory cannot be created
+
+      bool fetch( const string& key, const Signature& signature, vector<double>& values );
+      // reads the entry with the specified key into "values" and marks it
+      // most recently used; returns false (leaving "values" untouched) if
+      // there is no such entry, or if it has a different signature or does
+      // not have the size of "values"
+
+      bool store( const string& key, const Signature& signature, const vector<double>& values );
+      // writes an entry and evicts least recently used entries until the
+      // cache fits its capacity; returns false if the entry could not be
+      // written
+
+      size_t size( void );
+      // returns the total number of bytes of all entries
+
+      int nHits, nMisses;
+      // number of successful and unsuccessful calls to fetch()
+
+   protected:
+      class Entry
+      {
+         public:
+            string path;
+            size_t size;
+            long time; // last use, in seconds
+
+            bool operator<( const Entry& e ) const;
+            // orders entries from least to most recently used
+      };
+
+      void list( vector<Entry>& entries );
+      // finds all entries in the cache directory
+
+      void evict( void );
+      // deletes least recently used entries until the cache fits
+
+      string path( const string& key ) const;
+      // returns the file name of the entry with the specified key
+
+      string directory;
+      // directory holding one file per entry
+
+      size_t capacity;
+      // maximum total size of all entries in bytes
+};
+
+#endif
@@ -0,0 +1,75 @@
+// =============================================================================
+// SpinXForm -- Sequence.h
+//
+// Sequence computes an animation by deforming a single mesh once per frame,
+// for instance to animate a bulge or emboss effect.  The values of rho for
+// each frame come either from a sequence of images (or raw rho files), or
+// from a schedule of keyframes between which rho is interpolated linearly.
+// A schedule is a text file with one keyframe per line,
+//
+//    # frame  image.tga|rho.bin  [scale]
+//    0        flat.tga
+//    24       bump.tga           5
+//    48       flat.tga
+//
+// where the optional scale defaults to 5 for images and 1 for raw rho
+// files.  Since the mesh stays loaded, the Laplacian is factored only once
+// and the symbolic factorization of the eigenvalue matrix is reused for
+// every frame; each eigensolve is also warm-started from the previous
+// frame's solution.  The deformed vertices of all frames are streamed to a
+// single PC2 point cache (see PointCache.h).
+//
+
+#ifndef SPINXFORM_SEQUENCE_H
+#define SPINXFORM_SEQUENCE_H
+
+#include <string>
+#include <vector>
+#include "Mesh.h"
+
+using namespace std;
+
+class Sequence
+{
+   public:
+      Sequence( Mesh& mesh );
+      // creates an empty sequence for the specified (loaded) mesh
+
+      void readSchedule( const string& filename );
+      // reads keyframes from a schedule file (see above); throws Error
+      // if the file cannot be read or is malformed
+
+      void setFrames( const string& pattern, int first, int count );
+      // uses one keyframe per frame, for frames first, ..., first+count-1;
+      // the name of each image (or raw rho file) is given by the printf-
+      // style pattern, e.g., "bump%04d.tga"; throws Error unless the
+      // pattern contains exactly one integer conversion (and no other
+      // conversion except %%)
+
+      void run( const string& filename );
+      // computes every frame of the sequence and writes the deformed
+      // vertices to a PC2 point cache; throws Error on failure
+
+      Mesh::CurvatureSampling sampling;
+      // how images are averaged over each face
+
+   protected:
+      class Keyframe
+      {
+         public:
+            int frame;
+            string source; // image or raw rho file
+            double scale;
+      };
+
+      static bool earlier( const Keyframe& a, const Keyframe& b );
+      // orders keyframes by frame number
+
+      void load( const Keyframe& keyframe, vector<double>& rho );
+      // computes the values of rho for a keyframe
+
+      Mesh& mesh;
+      vector<Keyframe> keyframes; // sorted by frame
+};
+
+#endif
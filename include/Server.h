@@ -0,0 +1,95 @@
+// =============================================================================
+// SpinXForm -- Server.h
+//
+// Server runs SpinXForm as a long-lived daemon that listens on a Unix-domain
+// socket.  Loaded meshes (together with their prefactored Laplacians) stay in
+// memory between requests, up to a fixed number of meshes; once this limit
+// is reached the least recently used mesh is evicted.  Each request is a
+// single line of text, and each reply begins with a line starting with
+// either "ok" or "error":
+//
+//    load <name> <mesh.obj>            -> ok <#vertices> <#faces>
+//    image <name> <image.tga> <scale> [corners|mipmap|area] -> ok
+//    rho <name> <n>                    -> ok
+//       (followed by n doubles of raw binary data, one per face; if n is
+//       not the number of faces, the connection is closed after the reply)
+//    rhofile <name> <rho.bin> [scale]  -> ok
+//       (reads one raw double or float per face from a file)
+//    deform <name>                     -> ok <seconds>
+//    fetch <name>                      -> ok <#vertices>
+//       (reply is followed by 3*#vertices doubles of raw binary xyz data)
+//    unload <name>                     -> ok
+//    list                              -> ok <name> <name> ...
+//    quit                              -> ok (closes the connection)
+//    shutdown                          -> ok (stops the server)
+//
+// Binary data uses the native byte order of the machine running the server.
+// Requests are processed one connection at a time.
+//
+
+#ifndef SPINXFORM_SERVER_H
+#define SPINXFORM_SERVER_H
+
+#include <list>
+#include <map>
+#include <string>
+#include "Mesh.h"
+#include "Socket.h"
+
+using namespace std;
+
+class Server
+{
+   public:
+      Server( int capacity = 8 );
+      // creates a server that keeps at most "capacity" meshes in memory
+
+      ~Server( void );
+      // releases all cached meshes
+
+      bool run( const string& path );
+      // listens on the specified socket path and processes requests until
+      // a "shutdown" request is received; returns false if the socket
+      // could not be opened
+
+      ResultCache* resultCache;
+      // on-disk cache of deformations used by every mesh loaded from
+      // now on (NULL by default)
+
+   protected:
+      Server( const Server& s );
+      const Server& operator=( const Server& s );
+      // servers own their meshes and cannot be copied
+
+      bool serve( Socket& client );
+      // processes requests from a single client; returns false if the
+      // server should shut down
+
+      bool handle( Socket& client, const string& request, bool& done );
+      // processes a single request; returns false if the server
+      // should shut down
+
+      Mesh* find( const string& name );
+      // returns the named mesh (or NULL) and marks it most recently used
+
+      void insert( const string& name, Mesh* mesh );
+      // adds a mesh to the cache, evicting the least recently used
+      // mesh if the cache is full
+
+      void remove( const string& name );
+      // removes a mesh from the cache
+
+      typedef pair<string,Mesh*> Entry;
+      typedef list<Entry> EntryList;
+
+      EntryList entries;
+      // cached meshes, ordered from most to least recently used
+
+      map<string,EntryList::iterator> index;
+      // lookup from mesh name into the list of entries
+
+      int capacity;
+      // maximum number of cached meshes
+};
+
+#endif
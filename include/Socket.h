@@ -0,0 +1,78 @@
+// =============================================================================
+// SpinXForm -- Socket.h
+//
+// Socket is a thin wrapper around a Unix-domain stream socket, used by the
+// deformation server and its command-line client, and between the processes
+// of a domain-decomposed solve.  Messages consist of
+// newline-terminated text lines, optionally followed by a raw binary payload
+// whose size is announced in the preceding line.  For instance,
+//
+//    Socket s;
+//    if( s.connect( "/tmp/spinxform.sock" ))
+//    {
+//       s.writeLine( "deform bumpy" );
+//       string reply;
+//       s.readLine( reply );
+//    }
+//
+
+#ifndef SPINXFORM_SOCKET_H
+#define SPINXFORM_SOCKET_H
+
+#include <string>
+
+using namespace std;
+
+class Socket
+{
+   public:
+      Socket( void );
+      // creates a closed socket
+
+      ~Socket( void );
+      // closes the socket, if open
+
+      bool listen( const string& path );
+      // binds to the specified path and starts listening for connections;
+      // any stale socket file at this path is removed first
+
+      bool accept( Socket& client );
+      // waits for the next connection and hands it to "client"
+
+      bool connect( const string& path );
+      // connects to a server listening at the specified path
+
+      bool pair( Socket& other );
+      // connects this socket and "other" to each other (e.g., to
+      // communicate with a child process after fork())
+
+      void close( void );
+      // closes the connection (and removes the socket file if listening)
+
+      bool isOpen( void ) const;
+      // returns true if the socket is connected or listening
+
+      bool readLine( string& line );
+      // reads a single line (without the trailing newline)
+
+      bool writeLine( const string& line );
+      // writes a single line, appending a newline
+
+      bool read( void* data, size_t size );
+      // reads exactly "size" bytes
+
+      bool write( const void* data, size_t size );
+      // writes exactly "size" bytes; returns false (rather than raising
+      // SIGPIPE) if the other end has closed the connection
+
+   protected:
+      Socket( const Socket& s );
+      const Socket& operator=( const Socket& s );
+      // sockets own a file descriptor and cannot be copied
+
+      int fd; // file descriptor (-1 if closed)
+      string path; // socket file created by listen()
+      string buffer; // bytes received but not yet consumed
+};
+
+#endif
@@ -0,0 +1,35 @@
+// =============================================================================
+// SpinXForm -- SpinXForm.h
+//
+// Single header for applications that embed the solver (link against the
+// spinxform library built by CMake).  A mesh can be built directly from
+// in-memory arrays, deformed, and copied back without touching the disk:
+//
+//    Mesh mesh;
+//    mesh.verbose = false;
+//    mesh.build( positions, nVertices, indices, nFaces );  // xyz, 0-based triangles
+//    mesh.setCurvatureChange( rho );                      // one value per face
+//    mesh.updateDeformation();
+//    mesh.getPositions( result );                         // 3*nVertices values
+//
+// Invalid input is reported by throwing Error (see Error.h); the library
+// never terminates the process.  Changing rho and calling
+// updateDeformation() again reuses the factored Laplacian (and, if only a
+// few faces changed, the factored eigenvalue matrix).
+//
+// Each mesh has its own CHOLMOD environment, so different meshes may be
+// deformed from several threads at the same time; a single mesh must not
+// be used from more than one thread at once.  The number of threads used
+// by CHOLMOD, OpenMP and the BLAS (Common::setDefaultThreads()) is a
+// setting of the whole process, however, so it should be set before
+// deforming meshes concurrently.
+//
+
+#ifndef SPINXFORM_SPINXFORM_H
+#define SPINXFORM_SPINXFORM_H
+
+#include "Error.h"
+#include "Mesh.h"
+#include "Image.h"
+
+#endif
@@ -0,0 +1,72 @@
+// =============================================================================
+// SpinXForm -- Sweep.h
+//
+// Sweep deforms a single mesh for a list of curvature scales, e.g., to tune
+// the strength of an effect in one run.  The image (or raw rho file) is
+// sampled only once, at unit scale, and rho for each scale is obtained by
+// multiplying these values.  The first point of the sweep is solved in the
+// calling process, which factors the Laplacian and the eigenvalue matrix.
+// Every other point is then solved by a child process forked from it, so
+// that all points share the Laplacian factor and the symbolic analysis of
+// the eigenvalue matrix (copy-on-write), and each child only refactors the
+// eigenvalue matrix numerically.  Up to "nProcesses" children run at once.
+// Each point is written to its own file, named by a printf-style pattern
+// applied to the index of the point:
+//
+//    Sweep sweep( mesh );
+//    sweep.setScales( "1:10:.5" );
+//    sweep.load( "bumpy.tga" );
+//    sweep.run( "result%02d.obj" );
+//
+
+#ifndef SPINXFORM_SWEEP_H
+#define SPINXFORM_SWEEP_H
+
+#include <string>
+#include <vector>
+#include "Mesh.h"
+
+using namespace std;
+
+class Sweep
+{
+   public:
+      Sweep( Mesh& mesh );
+      // creates an empty sweep for the specified (loaded) mesh
+
+      void setScales( const string& list );
+      // sets the scales either from a comma-separated list, e.g.,
+      // "1,2.5,5", or from an inclusive range "first:last:step", e.g.,
+      // "1:10:.5"; throws Error if the list is malformed
+
+      void load( const string& source );
+      // samples an image, or reads a raw rho file, at unit scale (see
+      // Mesh::setCurvatureChange()); throws Error on failure
+
+      void run( const string& pattern );
+      // computes and writes every point of the sweep; throws Error if
+      // no scales were set, if the pattern does not contain exactly one
+      // integer conversion (and no other conversion except %%), or if
+      // any point fails
+
+      Mesh::CurvatureSampling sampling;
+      // how images are averaged over each face
+
+      int nProcesses;
+      // maximum number of points solved at once (the number of online
+      // processors by default); with 1, all points are solved in the
+      // calling process, which is required when the mesh uses domain
+      // decomposition, since its workers cannot be shared between processes
+
+      vector<double> scales;
+      // scale of each point
+
+   protected:
+      void solve( int k, const string& filename );
+      // computes point k of the sweep and writes it to a file
+
+      Mesh& mesh;
+      vector<double> rho1; // rho at unit scale
+};
+
+#endif
@@ -10,12 +10,26 @@
 #define SPINXFORM_UTILITY_H
 
 #include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <cctype>
+#include <sys/time.h>
 
 inline double sqr( double x )
 {
    return x*x;
 }
 
+inline double wallClock( void )
+// returns elapsed (wall-clock) time in seconds since an arbitrary
+// reference point; unlike clock(), this is meaningful for threaded code
+{
+   timeval t;
+   gettimeofday( &t, NULL );
+   return t.tv_sec + 1e-6 * t.tv_usec;
+}
+
 template <class T>
 inline void removeMean( std::vector<T>& v )
 {
@@ -34,6 +48,113 @@ inline void removeMean( std::vector<T>& v )
    }
 }
 
+inline void symmetricEigen( int n, double* A, double* values, double* vectors )
+// computes all eigenvalues and eigenvectors of the symmetric nxn matrix A
+// (stored in column-major order) using cyclic Jacobi rotations; on return
+// column i of "vectors" is the eigenvector for "values[i]", and A has
+// been overwritten
+{
+   for( int i = 0; i < n; i++ )
+   for( int j = 0; j < n; j++ )
+   {
+      vectors[i+n*j] = ( i == j ) ? 1. : 0.;
+   }
+
+   const int maxSweeps = 50;
+   for( int sweep = 0; sweep < maxSweeps; sweep++ )
+   {
+      // stop once the off-diagonal part is negligible
+      double off = 0., diagonal = 0.;
+      for( int i = 0; i < n; i++ )
+      for( int j = 0; j < n; j++ )
+      {
+         if( i == j ) diagonal += A[i+n*j]*A[i+n*j];
+         else              off += A[i+n*j]*A[i+n*j];
+      }
+      if( off <= 1e-30 * diagonal || off == 0. ) break;
+
+      for( int p = 0; p < n; p++ )
+      for( int q = p+1; q < n; q++ )
+      {
+         double apq = A[p+n*q];
+         if( apq == 0. ) continue;
+
+         // compute rotation that annihilates A(p,q)
+         double theta = ( A[q+n*q] - A[p+n*p] ) / ( 2.*apq );
+         double t = ( theta >= 0. ? 1. : -1. ) / ( fabs(theta) + sqrt( theta*theta + 1. ));
+         double c = 1. / sqrt( t*t + 1. );
+         double s = t*c;
+
+         // apply rotation to rows and columns p and q
+         for( int k = 0; k < n; k++ )
+         {
+            double akp = A[k+n*p];
+            double akq = A[k+n*q];
+            A[k+n*p] = c*akp - s*akq;
+            A[k+n*q] = s*akp + c*akq;
+         }
+         for( int k = 0; k < n; k++ )
+         {
+            double apk = A[p+n*k];
+            double aqk = A[q+n*k];
+            A[p+n*k] = c*apk - s*aqk;
+            A[q+n*k] = s*apk + c*aqk;
+         }
+         for( int k = 0; k < n; k++ )
+         {
+            double vkp = vectors[k+n*p];
+            double vkq = vectors[k+n*q];
+            vectors[k+n*p] = c*vkp - s*vkq;
+            vectors[k+n*q] = s*vkp + c*vkq;
+         }
+      }
+   }
+
+   for( int i = 0; i < n; i++ )
+   {
+      values[i] = A[i+n*i];
+   }
+}
+
+inline bool isRawArray( const std::string& filename )
+// raw per-face arrays of rho are recognized by their extension;
+// anything else is treated as an image
+{
+   size_t dot = filename.rfind( '.' );
+   if( dot == std::string::npos ) return false;
+
+   std::string extension = filename.substr( dot );
+   return extension == ".bin" || extension == ".raw" || extension == ".rho";
+}
+
+inline bool isIndexPattern( const std::string& pattern )
+// returns whether a printf-style pattern can be safely applied to a single
+// int, i.e., it contains exactly one conversion %d (optionally with a
+// width, as in %04d) and no other conversion except %%
+{
+   int nIndices = 0;
+   for( size_t i = 0; i < pattern.size(); i++ )
+   {
+      if( pattern[i] != '%' ) continue;
+
+      size_t j = i+1;
+      if( j < pattern.size() && pattern[j] == '%' )
+      {
+         i = j;
+         continue;
+      }
+
+      while( j < pattern.size() && isdigit( (unsigned char) pattern[j] )) j++;
+      if( j == pattern.size() || pattern[j] != 'd' )
+      {
+         return false;
+      }
+      nIndices++;
+      i = j;
+   }
+   return nIndices == 1;
+}
+
 inline bool bigEndian( void )
 {
    int n = 1;
@@ -52,4 +173,11 @@ inline void swapShort( short& x )
        (( x & 0xFF00 ) >> 8 ) ;
 }
 
+inline void swapFloat( float& x )
+{
+   char* c = (char*) &x;
+   std::swap( c[0], c[3] );
+   std::swap( c[1], c[2] );
+}
+
 #endif
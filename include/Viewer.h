@@ -8,13 +8,26 @@
 // function pointers, callbacks (and the subsequent members they access) are
 // declared static.
 //
+// Deformations are computed by a background thread so that the viewer stays
+// responsive.  The image (or raw rho file) is also watched for changes: once
+// it has been quiet for a moment, rho is reloaded and the surface is deformed
+// again in the background.  If another request arrives while a deformation
+// is being computed, the computation is abandoned after the eigenvalue
+// problem (or the stale result is dropped) and the newer request is
+// processed instead.  Only the worker modifies the mesh: resetting the
+// surface is posted to the worker like any other request, and drawing and
+// writing the result only use copies of the deformed positions and of rho,
+// which are updated when the worker publishes a result.
+//
 
 #ifndef SPINXFORM_VIEWER_H
 #define SPINXFORM_VIEWER_H
 
+#include <pthread.h>
 #include "Mesh.h"
 #include "Image.h"
 #include "Quaternion.h"
+#include "FileWatcher.h"
 
 //#ifdef mac
 //#include <GLUT/glut.h>
@@ -26,6 +39,9 @@ class Viewer
       static void init( void );
       static Mesh mesh;
       static Image image;
+      static string rhoFilename; // raw values of rho (used instead of image if nonempty)
+      static Mesh::CurvatureSampling sampling; // how the image is averaged over each face
+      static double scale; // image values are mapped to rho in [-scale,scale]
 
    protected:
 
@@ -62,13 +78,46 @@ class Viewer
       static Vector vertex( int faceIndex, int whichVertex );
       static Vector faceNormal( int faceIndex );
       static Vector barycenter( int faceIndex );
-      static void computeVertexNormals( void );
+      static void computeNormals( void );
       static double quasiConformalDistortion( int faceIndex );
       static Vector HSV( double h, double s, double v );
       static Vector qcColor( double qc );
       static void printQCDistortion( void );
       static void updateDisplayList( void );
-      static void reloadImage( void );
+      static bool reloadImage( void ); // returns false if rho could not be reloaded
+      static Vector deformedVertex( int i );
+
+      // background deformation
+      static void* work( void* );
+      // worker thread: reloads rho and computes the deformation whenever
+      // a new request arrives, discarding results that became stale
+
+      static void requestDeformation( void );
+      // asks the worker to reload rho and deform the surface again
+      // (superseding any request still being processed)
+
+      static void requestReset( void );
+      // asks the worker to restore the original surface (superseding any
+      // request still being processed)
+
+      static bool isStale( void );
+      // returns whether the request being processed by the worker has
+      // been superseded (polled by the mesh via Mesh::cancelled)
+
+      static void checkForResults( void );
+      // displays the latest result of the worker, if any
+
+      static FileWatcher watcher;        // watches the image (or rho file)
+      static double lastChange;          // time of the last unhandled change (or negative)
+      static pthread_t worker;           // background thread
+      static pthread_mutex_t stateMutex; // protects the members below
+      static pthread_cond_t requestCondition;
+      static int requested, completed;   // generation of the latest request and result
+      static int processing;             // generation being processed by the worker
+      static bool resetRequested;        // whether the latest request is a reset
+      static bool resultReady;           // whether a result awaits display
+      static vector<double> resultPositions, resultRho; // result of the worker
+      static vector<double> displayedPositions, displayedRho; // used for drawing
 
       // unique identifiers for menus
       enum
@@ -98,6 +147,7 @@ class Viewer
 
       static RenderMode mode;
       static double rhoMax;
+      static vector<Vector> faceNormals;
       static vector<Vector> vertexNormals;
       static double uvScale;
 
@@ -0,0 +1,165 @@
+// =============================================================================
+// SpinXForm -- BlockMatrix.cpp
+//
+// The product kernels work directly on the storage of quaternions (four
+// consecutive doubles; see Quaternion.h), and write each 4x4 block product
+// out as straight-line code so that the compiler can vectorize it.
+//
+
+#include <algorithm>
+#include "BlockMatrix.h"
+
+BlockMatrix :: BlockMatrix( void )
+// creates an empty matrix
+: m( 0 ),
+  n( 0 ),
+  rowStart( 1, 0 ),
+  columnStart( 1, 0 )
+{}
+
+BlockMatrix :: BlockMatrix( const QuaternionMatrix& A )
+// creates a copy of A
+{
+   build( A );
+}
+
+void BlockMatrix :: build( const QuaternionMatrix& A )
+// replaces this matrix with a copy of A
+{
+   m = A.size( 1 );
+   n = A.size( 2 );
+
+   // count entries in each row and column
+   rowStart.assign( m+1, 0 );
+   columnStart.assign( n+1, 0 );
+   for( QuaternionMatrix::const_iterator e = A.begin(); e != A.end(); e++ )
+   {
+      rowStart[ e->first.second+1 ]++;
+      columnStart[ e->first.first+1 ]++;
+   }
+   for( int i = 0; i < m; i++ ) rowStart[i+1] += rowStart[i];
+   for( int j = 0; j < n; j++ ) columnStart[j+1] += columnStart[j];
+
+   // copy entries (since A is stored in column-major order, the entries
+   // of each row are visited by increasing column, and the entries of
+   // each column are visited consecutively)
+   int nnz = rowStart[m];
+   column.resize( nnz );
+   values.resize( nnz );
+   entry.resize( nnz );
+   entryRow.resize( nnz );
+
+   vector<int> next( rowStart.begin(), rowStart.end()-1 );
+   int k = 0;
+   for( QuaternionMatrix::const_iterator e = A.begin(); e != A.end(); e++ )
+   {
+      int p = next[ e->first.second ]++;
+      column[p] = e->first.first;
+      values[p] = e->second;
+      entryRow[k] = e->first.second;
+      entry[k++] = p;
+   }
+}
+
+int BlockMatrix :: size( int dim ) const
+// returns the size of the dimension specified by scalar dim
+{
+   if( dim == 1 ) return m;
+   if( dim == 2 ) return n;
+   return 0;
+}
+
+int BlockMatrix :: nBlocks( void ) const
+// returns the number of nonzero (quaternion) entries
+{
+   return values.size();
+}
+
+void BlockMatrix :: getDiagonal( vector<Quaternion>& d ) const
+// copies the diagonal entries into d
+{
+   d.assign( min( m, n ), 0. );
+   if( column.empty() ) return;
+
+   for( int i = 0; i < (int) d.size(); i++ )
+   {
+      // (columns are sorted within each row)
+      const int* begin = &column[0] + rowStart[i];
+      const int* end   = &column[0] + rowStart[i+1];
+      const int* p = lower_bound( begin, end, i );
+      if( p != end && *p == i )
+      {
+         d[i] = values[ p - &column[0] ];
+      }
+   }
+}
+
+void BlockMatrix :: multiply( const vector<Quaternion>& x, vector<Quaternion>& y ) const
+// computes y = Ax
+{
+   y.resize( m );
+   if( m == 0 ) return;
+
+   const double* X = reinterpret_cast<const double*>( &x[0] );
+   const double* Q = reinterpret_cast<const double*>( &values[0] );
+   double* Y = reinterpret_cast<double*>( &y[0] );
+
+   #pragma omp parallel for schedule(static)
+   for( int i = 0; i < m; i++ )
+   {
+      double y0 = 0., y1 = 0., y2 = 0., y3 = 0.;
+
+      for( int p = rowStart[i]; p < rowStart[i+1]; p++ )
+      {
+         // Hamilton product q*x, i.e., the 4x4 block of q times x
+         const double* q = &Q[ 4*p ];
+         const double* xj = &X[ 4*column[p] ];
+         y0 += q[0]*xj[0] - q[1]*xj[1] - q[2]*xj[2] - q[3]*xj[3];
+         y1 += q[1]*xj[0] + q[0]*xj[1] - q[3]*xj[2] + q[2]*xj[3];
+         y2 += q[2]*xj[0] + q[3]*xj[1] + q[0]*xj[2] - q[1]*xj[3];
+         y3 += q[3]*xj[0] - q[2]*xj[1] + q[1]*xj[2] + q[0]*xj[3];
+      }
+
+      Y[ 4*i+0 ] = y0;
+      Y[ 4*i+1 ] = y1;
+      Y[ 4*i+2 ] = y2;
+      Y[ 4*i+3 ] = y3;
+   }
+}
+
+void BlockMatrix :: multiplyTranspose( const vector<Quaternion>& x, vector<Quaternion>& y ) const
+// computes y = A'x
+{
+   y.resize( n );
+   if( n == 0 ) return;
+
+   const double* X = reinterpret_cast<const double*>( &x[0] );
+   const double* Q = reinterpret_cast<const double*>( &values[0] );
+   double* Y = reinterpret_cast<double*>( &y[0] );
+
+   #pragma omp parallel for schedule(static)
+   for( int j = 0; j < n; j++ )
+   {
+      double y0 = 0., y1 = 0., y2 = 0., y3 = 0.;
+
+      for( int k = columnStart[j]; k < columnStart[j+1]; k++ )
+      {
+         int p = entry[k];
+         int i = entryRow[k];
+
+         // conjugate product ~q*x, i.e., the transposed 4x4 block of q times x
+         const double* q = &Q[ 4*p ];
+         const double* xi = &X[ 4*i ];
+         y0 += q[0]*xi[0] + q[1]*xi[1] + q[2]*xi[2] + q[3]*xi[3];
+         y1 += q[0]*xi[1] - q[1]*xi[0] + q[3]*xi[2] - q[2]*xi[3];
+         y2 += q[0]*xi[2] - q[2]*xi[0] - q[3]*xi[1] + q[1]*xi[3];
+         y3 += q[0]*xi[3] - q[3]*xi[0] + q[2]*xi[1] - q[1]*xi[2];
+      }
+
+      Y[ 4*j+0 ] = y0;
+      Y[ 4*j+1 ] = y1;
+      Y[ 4*j+2 ] = y2;
+      Y[ 4*j+3 ] = y3;
+   }
+}
+
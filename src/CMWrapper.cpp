@@ -5,17 +5,50 @@
 //
 
 #include "CMWrapper.h"
+#include "Hash.h"
 #include <algorithm>
+#include <list>
 #include <cassert>
 #include <cmath>
+#include <cstdlib>
+#include <pthread.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 
+// thread controls of multithreaded BLAS libraries; these are declared weak
+// so that they are null unless the corresponding library is linked
+extern "C"
+{
+   void openblas_set_num_threads( int n ) __attribute__(( weak ));
+   void bli_thread_set_num_threads( long n ) __attribute__(( weak ));
+}
+
 namespace cm
 {
+   // number of threads used by CHOLMOD in environments that follow the
+   // default: the value of the most recent call to setDefaultThreads(),
+   // initially taken from the environment (-1 until the environment has
+   // been read)
+   static int defaultThreads = -1;
+
    Common :: Common( void )
+   : nThreads( 0 )
    {
       cholmod_l_start( &common );
+
+      if( defaultThreads < 0 )
+      {
+         defaultThreads = 0;
+
+         const char* threads = getenv( "SPINXFORM_THREADS" );
+         if( threads )
+         {
+            setDefaultThreads( atoi( threads ));
+         }
+      }
    }
 
    Common :: ~Common( void )
@@ -25,16 +58,57 @@ namespace cm
 
    Common :: operator cholmod_common*( void )
    {
+#if CHOLMOD_MAIN_VERSION >= 4
+      // (the default is applied on every use, so that it also reaches
+      // environments created before it was set; zero means that CHOLMOD
+      // uses the OpenMP default)
+      common.nthreads_max = nThreads > 0 ? nThreads : max( 0, defaultThreads );
+#endif
       return &common;
    }
 
+   void Common :: setDefaultThreads( int n )
+   {
+      defaultThreads = max( 0, n );
+
+#ifdef _OPENMP
+      omp_set_num_threads( n > 0 ? n : omp_get_num_procs() );
+#endif
+
+      // multithreaded BLAS libraries have their own thread pools
+      if( n > 0 )
+      {
+         if( openblas_set_num_threads ) openblas_set_num_threads( n );
+         if( bli_thread_set_num_threads ) bli_thread_set_num_threads( n );
+      }
+   }
+
+   void Common :: limitThreads( int n )
+   {
+      nThreads = max( 0, n );
+   }
+
+   int Common :: threads( void )
+   {
+      if( defaultThreads > 0 )
+      {
+         return defaultThreads;
+      }
+#ifdef _OPENMP
+      return omp_get_max_threads();
+#else
+      return 1;
+#endif
+   }
+
    Sparse :: Sparse( Common& _common, int _m, int _n, int _xtype )
    : common( _common ),
      m( _m ),
      n( _n ),
      xtype( _xtype ),
      stype( 0 ),
-     A( NULL )
+     A( NULL ),
+     data( EntryMap::key_compare(), EntryMap::allocator_type( &pool ))
    {}
 
    Upper :: Upper( Common& _common, int _m, int _n, int _xtype )
@@ -56,7 +130,10 @@ namespace cm
       m = _m;
       n = _n;
 
+      // (entries are returned to the pool, which hands out the same
+      // memory again for the next assembly)
       data.clear();
+      pool.reset();
    }
 
    int Sparse :: size( int dim ) const
@@ -83,7 +160,7 @@ namespace cm
 
    void Sparse :: transpose( void )
    {
-      EntryMap transposed;
+      EntryMap transposed( data.key_comp(), data.get_allocator() );
 
       for( const_iterator e = data.begin(); e != data.end(); e++ )
       {
@@ -92,7 +169,7 @@ namespace cm
          transposed[ EntryIndex( j, i ) ] = e->second;
       }
 
-      data = transposed;
+      data.swap( transposed );
       swap( m, n );
    }
 
@@ -221,18 +298,24 @@ namespace cm
       return data.end();
    }
 
+   size_t Sparse :: peakMemory( void ) const
+   {
+      return pool.peakUsage();
+   }
+
    double& Sparse :: retrieveEntry( int row, int col, int c )
    {
       EntryIndex index( col, row );
 
-      EntryMap::const_iterator entry = data.find( index );
-      if( entry == data.end())
+      // find the entry, inserting a zero if necessary (with a single search)
+      iterator entry = data.lower_bound( index );
+      if( entry == data.end() || entry->first != index )
       {
-         data[ index ] = EntryValue( 0., 0. );
+         entry = data.insert( entry, EntryMap::value_type( index, EntryValue( 0., 0. )));
       }
 
-      if( c == CHOLMOD_REAL ) return data[ index ].first;
-      else             return data[ index ].second;
+      if( c == CHOLMOD_REAL ) return entry->second.first;
+      else                    return entry->second.second;
    }
 
    double Sparse :: retrieveEntry( int row, int col, int c ) const
@@ -277,9 +360,37 @@ namespace cm
       *this = A;
    }
 
+   Dense :: Dense( Common& _common, double* x, int _m, int _n )
+   : common( _common ),
+     m( _m ),
+     n( _n ),
+     xtype( CHOLMOD_REAL ),
+     data( &header ),
+     rData( x ),
+     iData( NULL )
+   {
+      header.nrow = m;
+      header.ncol = n;
+      header.nzmax = m*n;
+      header.d = m;
+      header.x = x;
+      header.z = NULL;
+      header.xtype = CHOLMOD_REAL;
+      header.dtype = CHOLMOD_DOUBLE;
+   }
+
    Dense :: ~Dense( void )
    {
-      if( data ) cholmod_l_free_dense( &data, common );
+      release();
+   }
+
+   void Dense :: release( void )
+   {
+      if( data && data != &header )
+      {
+         cholmod_l_free_dense( &data, common );
+      }
+      data = NULL;
    }
 
    cholmod_dense* Dense :: operator*( void )
@@ -303,7 +414,7 @@ namespace cm
 
    const Dense& Dense :: operator=( const Dense& A )
    {
-      if( data ) { cholmod_l_free_dense( &data, common ); data = NULL; }
+      release();
 
       data = cholmod_l_copy_dense( A.data, common );
 
@@ -314,7 +425,7 @@ namespace cm
 
    const Dense& Dense :: operator=( cholmod_dense* A )
    {
-      if( data ) { cholmod_l_free_dense( &data, common ); data = NULL; }
+      release();
 
       data = A;
 
@@ -365,7 +476,7 @@ namespace cm
       n = A.n + B.n;
       xtype = A.xtype;
 
-      if( data ) { cholmod_l_free_dense( &data, common ); data = NULL; }
+      release();
       data = cholmod_l_allocate_dense( m, n, m, xtype, common );
       rData = (double*) data->x;
       if( xtype == CHOLMOD_ZOMPLEX )
@@ -403,7 +514,7 @@ namespace cm
       n = A.n;
       xtype = A.xtype;
 
-      if( data ) { cholmod_l_free_dense( &data, common ); data = NULL; }
+      release();
       data = cholmod_l_allocate_dense( m, n, m, xtype, common );
       rData = (double*) data->x;
       if( xtype == CHOLMOD_ZOMPLEX )
@@ -447,7 +558,15 @@ namespace cm
 
    Factor :: Factor( Common& _common )
    : common( _common ),
-     L( NULL )
+     L( NULL ),
+     S( NULL ),
+     Y( NULL ),
+     E( NULL ),
+     ordering( orderDefault ),
+     mode( modeAuto ),
+     lnz( 0. ),
+     fl( 0. ),
+     shared( false )
    {}
 
    Factor :: ~Factor( void )
@@ -456,6 +575,9 @@ namespace cm
       {
          cholmod_l_free_factor( &L, common );
       }
+      if( S ) cholmod_l_free_factor( &S, common );
+      if( Y ) cholmod_l_free_dense( &Y, common );
+      if( E ) cholmod_l_free_dense( &E, common );
    }
 
    void Factor :: build( Upper& A )
@@ -466,10 +588,309 @@ namespace cm
          L = NULL;
       }
 
-      L = cholmod_l_analyze( *A, common );
+      cholmod_sparse* a = *A;
+      analyze( a );
+      shared = false;
+      keepAnalysis();
+      cholmod_l_factorize( a, L, common );
+   }
+
+   // analyses shared between factors (see Factor::build()), ordered from
+   // most to least recently used; the list is allocated on first use and
+   // never destroyed, since its factors may outlive any Common object
+   class SharedAnalysis
+   {
+      public:
+         std::string key;
+         cholmod_factor* L; // symbolic factor
+         double lnz, fl;
+   };
+   static list<SharedAnalysis>* sharedAnalyses = NULL;
+   static pthread_mutex_t sharedAnalysesMutex = PTHREAD_MUTEX_INITIALIZER;
+
+   void Factor :: build( Upper& A, const string& key )
+   {
+      if( L )
+      {
+         cholmod_l_free_factor( &L, common );
+         L = NULL;
+      }
+
+      cholmod_sparse* a = *A;
+      string k = analysisKey( a, key );
+
+      // look for an existing analysis
+      pthread_mutex_lock( &sharedAnalysesMutex );
+      if( !sharedAnalyses ) sharedAnalyses = new list<SharedAnalysis>;
+      for( list<SharedAnalysis>::iterator s = sharedAnalyses->begin(); s != sharedAnalyses->end(); s++ )
+      {
+         if( s->key == k )
+         {
+            L = cholmod_l_copy_factor( s->L, common );
+            lnz = s->lnz;
+            fl = s->fl;
+            sharedAnalyses->splice( sharedAnalyses->begin(), *sharedAnalyses, s );
+            break;
+         }
+      }
+      pthread_mutex_unlock( &sharedAnalysesMutex );
+      shared = L != NULL;
+
+      // otherwise, analyze A and share a copy of the result (the
+      // numeric factorization below turns L itself into a real factor)
+      if( !L )
+      {
+         analyze( a );
+         if( L )
+         {
+            SharedAnalysis s;
+            s.key = k;
+            s.L = cholmod_l_copy_factor( L, common );
+            s.lnz = lnz;
+            s.fl = fl;
+
+            pthread_mutex_lock( &sharedAnalysesMutex );
+            sharedAnalyses->push_front( s );
+            while( (int) sharedAnalyses->size() > maxSharedAnalyses )
+            {
+               cholmod_l_free_factor( &sharedAnalyses->back().L, common );
+               sharedAnalyses->pop_back();
+            }
+            pthread_mutex_unlock( &sharedAnalysesMutex );
+         }
+      }
+
+      keepAnalysis();
+      cholmod_l_factorize( a, L, common );
+   }
+
+   void Factor :: keepAnalysis( void )
+   {
+      if( S )
+      {
+         cholmod_l_free_factor( &S, common );
+         S = NULL;
+      }
+
+      // (a symbolic factor holds only the pattern, so the copy is
+      // small compared to the numeric factor)
+      if( L && L->is_super )
+      {
+         S = cholmod_l_copy_factor( L, common );
+      }
+   }
+
+   bool Factor :: sharedAnalysis( void ) const
+   {
+      return shared;
+   }
+
+   string Factor :: analysisKey( cholmod_sparse* A, const string& key ) const
+   {
+      Hash hash;
+      hash.add( key.data(), key.size() );
+
+      // ordering settings
+      hash.add( (int) ordering );
+      hash.add( (int) mode );
+      if( ordering == orderCAMD  ) hash.add( constraints );
+      if( ordering == orderGiven ) hash.add( permutation );
+
+      // pattern of A (which need not be determined by the key alone,
+      // e.g., if some entries happen to be zero and were not stored)
+      SuiteSparse_long n = A->ncol;
+      const SuiteSparse_long* p = (const SuiteSparse_long*) A->p;
+      hash.add( A->nrow );
+      hash.add( n );
+      hash.add( p, (n+1)*sizeof(SuiteSparse_long) );
+      hash.add( A->i, p[n]*sizeof(SuiteSparse_long) );
+
+      return hash.hex();
+   }
+
+   void Factor :: setOrdering( Ordering _ordering, Mode _mode )
+   {
+      ordering = _ordering;
+      mode = _mode;
+   }
+
+   void Factor :: setConstraints( const vector<SuiteSparse_long>& _constraints )
+   {
+      constraints = _constraints;
+   }
+
+   void Factor :: setPermutation( const vector<SuiteSparse_long>& _permutation )
+   {
+      permutation = _permutation;
+   }
+
+   void Factor :: analyze( cholmod_sparse* A )
+   {
+      cholmod_common* c = common;
+      int n = A->nrow;
+
+      // save settings shared with other factors
+      int nmethods = c->nmethods;
+      int methodOrdering = c->method[0].ordering;
+      int postorder = c->postorder;
+      int supernodal = c->supernodal;
+
+      switch( mode )
+      {
+         case modeSimplicial: c->supernodal = CHOLMOD_SIMPLICIAL; break;
+         case modeSupernodal: c->supernodal = CHOLMOD_SUPERNODAL; break;
+         default:             c->supernodal = CHOLMOD_AUTO;       break;
+      }
+
+      // compute CAMD ordering, which is then used as a given permutation
+      vector<SuiteSparse_long> perm;
+      if( ordering == orderCAMD )
+      {
+         vector<SuiteSparse_long> cmember( constraints );
+         cmember.resize( n, 0 );
+         perm.resize( n );
+         if( !cholmod_l_camd( A, NULL, 0, &cmember[0], &perm[0], common ))
+         {
+            perm.clear();
+         }
+      }
+      else if( ordering == orderGiven && (int) permutation.size() == n )
+      {
+         perm = permutation;
+      }
+
+      if( !perm.empty() )
+      {
+         c->nmethods = 1;
+         c->method[0].ordering = CHOLMOD_GIVEN;
+         c->postorder = ordering != orderCAMD; // postordering would break constraints
+         L = cholmod_l_analyze_p( A, &perm[0], NULL, 0, common );
+      }
+      else
+      {
+         if( ordering != orderDefault )
+         {
+            int method = CHOLMOD_AMD;
+            if( ordering == orderNatural ) method = CHOLMOD_NATURAL;
+            if( ordering == orderMETIS   ) method = CHOLMOD_METIS;
+            if( ordering == orderNESDIS  ) method = CHOLMOD_NESDIS;
+
+            c->nmethods = 1;
+            c->method[0].ordering = method;
+         }
+
+         L = cholmod_l_analyze( A, common );
+
+         // METIS may be unavailable
+         if( !L && ( ordering == orderMETIS || ordering == orderNESDIS ))
+         {
+            c->method[0].ordering = CHOLMOD_AMD;
+            L = cholmod_l_analyze( A, common );
+         }
+      }
+
+      lnz = c->lnz;
+      fl = c->fl;
+
+      // restore settings
+      c->nmethods = nmethods;
+      c->method[0].ordering = methodOrdering;
+      c->postorder = postorder;
+      c->supernodal = supernodal;
+   }
+
+   double Factor :: nnz( void ) const
+   {
+      return lnz;
+   }
+
+   double Factor :: flops( void ) const
+   {
+      return fl;
+   }
+
+   double Factor :: rcond( void )
+   {
+      if( !L )
+      {
+         return 0.;
+      }
+
+      return cholmod_l_rcond( L, common );
+   }
+
+   bool Factor :: succeeded( void )
+   {
+      cholmod_common* c = common;
+      return L && c->status == CHOLMOD_OK && L->minor == L->n;
+   }
+
+   void Factor :: refactor( Upper& A )
+   {
+      if( !L )
+      {
+         build( A );
+         return;
+      }
+
+      // start over from the supernodal analysis if updown() converted L
+      if( S && !L->is_super )
+      {
+         cholmod_l_free_factor( &L, common );
+         L = cholmod_l_copy_factor( S, common );
+      }
+
       cholmod_l_factorize( *A, L, common );
    }
 
+   bool Factor :: updown( Sparse& C, bool update )
+   {
+      if( !L )
+      {
+         return false;
+      }
+
+      // updates and downdates operate on a simplicial LDL' factorization
+      if( L->is_super || L->is_ll )
+      {
+         cholmod_l_change_factor( CHOLMOD_REAL, false, false, false, false, L, common );
+      }
+
+      // rows of C must be permuted according to the fill-reducing ordering
+      cholmod_sparse* PC = cholmod_l_submatrix( *C, (SuiteSparse_long*) L->Perm, L->n, NULL, -1, true, true, common );
+      int ok = cholmod_l_updown( update, PC, L, common );
+      cholmod_l_free_sparse( &PC, common );
+
+      cholmod_common* c = common;
+      return ok && c->status == CHOLMOD_OK && L->minor == L->n;
+   }
+
+   void Factor :: solve( Dense& x, Dense& b )
+   {
+      assert( L );
+      assert( b.size(1) == (int) L->n );
+      assert( x.size(1) == b.size(1) && x.size(2) == b.size(2) );
+
+      // CHOLMOD writes the solution into the storage of x only if its
+      // layout matches exactly; otherwise it would free x (which may be
+      // external storage) and allocate a new matrix, so in that case the
+      // solution goes to a temporary matrix and is copied into x
+      cholmod_dense* x0 = *x;
+      bool inPlace = x0->d == x0->nrow && x0->xtype == (*b)->xtype;
+      cholmod_dense* X = inPlace ? x0 : NULL;
+      cholmod_l_solve2( CHOLMOD_A, L, *b, NULL, &X, NULL, &Y, &E, common );
+      if( X != x0 )
+      {
+         cholmod_l_copy_dense2( X, x0, common );
+         cholmod_l_free_dense( &X, common );
+      }
+   }
+
+   int Factor :: size( void ) const
+   {
+      return L ? L->n : 0;
+   }
+
    cholmod_factor* Factor :: operator*( void )
    {
       return L;
@@ -0,0 +1,643 @@
+// =============================================================================
+// SpinXForm -- DomainSolver.cpp
+//
+// Workers understand the following commands, each followed by raw binary
+// data (whose size the worker already knows):
+//
+//    factor <nI> <nG> <nA> <nB>  -> ok <nnz>
+//       (followed by the rows, columns and values of the nA entries of the
+//       upper triangle of A_II and of the nB entries of A_IG, where nI and
+//       nG are the numbers of interior and coupled interface rows)
+//    interior                    -> ok
+//       (followed by b_I; replies with A_GI A_II^-1 b_I)
+//    schur                       -> ok
+//       (followed by v_G; replies with A_GI A_II^-1 A_IG v_G)
+//    back                        -> ok
+//       (followed by x_G; replies with A_II^-1 ( b_I - A_IG x_G ), using
+//       b_I from the previous "interior" command)
+//
+//    quit                        -> (no reply; the worker exits)
+//
+// Workers also exit as soon as the connection is closed.
+//
+
+#include <iostream>
+#include <cmath>
+#include <cassert>
+#include <sstream>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+#include "DomainSolver.h"
+#include "Error.h"
+
+template <class T>
+static bool send( Socket& s, const vector<T>& v )
+// writes the entries of v as raw binary data
+{
+   return v.empty() || s.write( &v[0], v.size()*sizeof(T) );
+}
+
+template <class T>
+static bool receive( Socket& s, vector<T>& v, int n )
+// reads n entries of raw binary data into v
+{
+   v.resize( n );
+   return n == 0 || s.read( &v[0], n*sizeof(T) );
+}
+
+static double dot( const vector<double>& u, const vector<double>& v )
+// returns the inner product of u and v
+{
+   double sum = 0.;
+   for( size_t i = 0; i < u.size(); i++ )
+   {
+      sum += u[i]*v[i];
+   }
+   return sum;
+}
+
+DomainSolver :: DomainSolver( void )
+// creates a solver without any workers
+: tolerance( 1e-10 ),
+  maxIterations( 1000 ),
+  nIterations( 0 ),
+  residual( 0. ),
+  n( 0 ),
+  lnz( 0. )
+{}
+
+DomainSolver :: ~DomainSolver( void )
+// stops all workers
+{
+   stop();
+}
+
+void DomainSolver :: start( int nPatches )
+// forks one worker process per patch
+{
+   stop();
+
+   for( int p = 0; p < nPatches; p++ )
+   {
+      Socket* master = new Socket;
+      Socket child;
+      if( !master->pair( child ))
+      {
+         delete master;
+         stop();
+         throw Error( "couldn't connect to domain solver worker" );
+      }
+
+      pid_t pid = fork();
+      if( pid < 0 )
+      {
+         delete master;
+         stop();
+         throw Error( "couldn't start domain solver worker" );
+      }
+
+      if( pid == 0 )
+      {
+         // keep only the connection to the master, so that every worker
+         // sees the end of its stream as soon as the master hangs up
+         master->close();
+         for( size_t q = 0; q < workers.size(); q++ )
+         {
+            workers[q]->close();
+         }
+
+#ifdef __linux__
+         // also exit if the master dies without hanging up
+         prctl( PR_SET_PDEATHSIG, SIGTERM );
+#endif
+
+         // (exit without running the destructors of the master's objects)
+         try
+         {
+            work( child );
+         }
+         catch( ... )
+         {
+            _exit( 1 );
+         }
+         _exit( 0 );
+      }
+
+      child.close();
+      workers.push_back( master );
+      pids.push_back( pid );
+   }
+}
+
+void DomainSolver :: stop( void )
+// stops all workers
+{
+   // (workers are asked to quit explicitly, since other worker processes
+   // may hold copies of this end of their connections)
+   for( size_t p = 0; p < workers.size(); p++ )
+   {
+      workers[p]->writeLine( "quit" );
+      workers[p]->close();
+   }
+
+   for( size_t p = 0; p < workers.size(); p++ )
+   {
+      waitpid( pids[p], NULL, 0 );
+      delete workers[p];
+   }
+
+   workers.clear();
+   pids.clear();
+   n = 0;
+   lnz = 0.;
+}
+
+void DomainSolver :: build( Upper& A, const vector<int>& patch )
+// splits A into blocks, and has each worker factor its interior block
+{
+   int nP = workers.size();
+   if( nP == 0 )
+   {
+      throw Error( "domain solver has no workers" );
+   }
+
+   n = A.size( 1 );
+   if( (int) patch.size() != n )
+   {
+      throw Error( "domain solver needs one patch per matrix row" );
+   }
+
+   for( int i = 0; i < n; i++ )
+   {
+      if( patch[i] < 0 || patch[i] >= nP )
+      {
+         throw Error( "domain solver patch out of range" );
+      }
+   }
+
+   // put both ends of every entry coupling two patches on the interface
+   // (only the upper triangle of A is used)
+   vector<bool> onInterface( n, false );
+   for( Sparse::const_iterator e = A.begin(); e != A.end(); e++ )
+   {
+      int r = e->first.second;
+      int c = e->first.first;
+      if( r <= c && patch[r] != patch[c] )
+      {
+         onInterface[r] = onInterface[c] = true;
+      }
+   }
+
+   // number interface rows and the interior rows of each patch
+   vector<int> local( n );
+   interface.clear();
+   interior.assign( nP, vector<int>() );
+   for( int i = 0; i < n; i++ )
+   {
+      vector<int>& rows( onInterface[i] ? interface : interior[ patch[i] ] );
+      local[i] = rows.size();
+      rows.push_back( i );
+   }
+
+   // split entries into interior blocks A_II, coupling blocks A_IG,
+   // and the interface block A_GG
+   vector< vector<int> > aRow( nP ), aCol( nP ), bRow( nP ), bCol( nP );
+   vector< vector<double> > aValue( nP ), bValue( nP );
+   ggRow.clear();
+   ggCol.clear();
+   ggValue.clear();
+   ggDiagonal.assign( interface.size(), 0. );
+   for( Sparse::const_iterator e = A.begin(); e != A.end(); e++ )
+   {
+      int r = e->first.second;
+      int c = e->first.first;
+      double value = e->second.first;
+      if( r > c ) continue;
+
+      if( onInterface[r] && onInterface[c] )
+      {
+         ggRow.push_back( local[r] );
+         ggCol.push_back( local[c] );
+         ggValue.push_back( value );
+         if( r == c ) ggDiagonal[ local[r] ] += value;
+      }
+      else if( !onInterface[r] && !onInterface[c] )
+      {
+         int p = patch[r];
+         aRow[p].push_back( local[r] );
+         aCol[p].push_back( local[c] );
+         aValue[p].push_back( value );
+      }
+      else
+      {
+         int i = onInterface[r] ? c : r;
+         int g = onInterface[r] ? r : c;
+         int p = patch[i];
+         bRow[p].push_back( local[i] );
+         bCol[p].push_back( local[g] );
+         bValue[p].push_back( value );
+      }
+   }
+
+   // number the interface rows coupled to each patch
+   coupled.assign( nP, vector<int>() );
+   for( int p = 0; p < nP; p++ )
+   {
+      vector<int>& g( coupled[p] );
+      g = bCol[p];
+      sort( g.begin(), g.end() );
+      g.erase( unique( g.begin(), g.end() ), g.end() );
+
+      for( size_t k = 0; k < bCol[p].size(); k++ )
+      {
+         bCol[p][k] = lower_bound( g.begin(), g.end(), bCol[p][k] ) - g.begin();
+      }
+   }
+
+   // send blocks to the workers, which factor them in parallel
+   for( int p = 0; p < nP; p++ )
+   {
+      stringstream command;
+      command << "factor " << interior[p].size() << " " << coupled[p].size()
+              << " " << aValue[p].size() << " " << bValue[p].size();
+
+      Socket& s( *workers[p] );
+      if( !s.writeLine( command.str() ) ||
+          !send( s, aRow[p] ) || !send( s, aCol[p] ) || !send( s, aValue[p] ) ||
+          !send( s, bRow[p] ) || !send( s, bCol[p] ) || !send( s, bValue[p] ))
+      {
+         stop();
+         throw Error( "lost connection to domain solver worker" );
+      }
+   }
+
+   lnz = 0.;
+   string error;
+   for( int p = 0; p < nP; p++ )
+   {
+      string reply, status;
+      double nnz = 0.;
+      if( !workers[p]->readLine( reply ))
+      {
+         error = "lost connection to domain solver worker";
+         continue;
+      }
+
+      stringstream in( reply );
+      in >> status;
+      if( status != "ok" )
+      {
+         // (the reply is "error <message>")
+         getline( in >> ws, error );
+         if( error.empty() ) error = "domain solver worker failed";
+         continue;
+      }
+      in >> nnz;
+      lnz += nnz;
+   }
+
+   if( !error.empty() )
+   {
+      stop();
+      throw Error( error );
+   }
+}
+
+void DomainSolver :: solve( Dense& x, Dense& b )
+// solves Ax = b
+{
+   assert( b.size(1) == n && x.size(1) == n );
+   double* xData = (double*) (*x)->x;
+   const double* bData = (const double*) (*b)->x;
+
+   int nP = workers.size();
+   int nG = interface.size();
+   vector< vector<double> > data( nP );
+
+   // eliminate interior unknowns: g = b_G - A_GI A_II^-1 b_I
+   for( int p = 0; p < nP; p++ )
+   {
+      data[p].resize( interior[p].size() );
+      for( size_t k = 0; k < interior[p].size(); k++ )
+      {
+         data[p][k] = bData[ interior[p][k] ];
+      }
+   }
+   broadcast( "interior", data );
+
+   for( int p = 0; p < nP; p++ ) data[p].resize( coupled[p].size() );
+   gather( data );
+
+   vector<double> g( nG );
+   for( int i = 0; i < nG; i++ )
+   {
+      g[i] = bData[ interface[i] ];
+   }
+   for( int p = 0; p < nP; p++ )
+   for( size_t k = 0; k < coupled[p].size(); k++ )
+   {
+      g[ coupled[p][k] ] -= data[p][k];
+   }
+
+   // solve the Schur complement system for the interface unknowns
+   // using conjugate gradients, preconditioned by the diagonal of A_GG
+   vector<double> xG( nG, 0. ), r( g ), z( nG ), d( nG ), q( nG );
+   vector<double> invDiagonal( nG );
+   for( int i = 0; i < nG; i++ )
+   {
+      invDiagonal[i] = ggDiagonal[i] > 0. ? 1./ggDiagonal[i] : 1.;
+      z[i] = d[i] = invDiagonal[i] * r[i];
+   }
+
+   double g2 = dot( g, g );
+   double r2 = g2;
+   double rz = dot( r, z );
+   nIterations = 0;
+   while( r2 > tolerance*tolerance*g2 && nIterations < maxIterations )
+   {
+      applySchur( d, q );
+      double alpha = rz / dot( d, q );
+
+      for( int i = 0; i < nG; i++ )
+      {
+         xG[i] += alpha * d[i];
+         r[i] -= alpha * q[i];
+         z[i] = invDiagonal[i] * r[i];
+      }
+
+      double rzNext = dot( r, z );
+      double beta = rzNext / rz;
+      rz = rzNext;
+
+      for( int i = 0; i < nG; i++ )
+      {
+         d[i] = z[i] + beta * d[i];
+      }
+
+      r2 = dot( r, r );
+      nIterations++;
+   }
+   residual = g2 > 0. ? sqrt( r2 / g2 ) : 0.;
+   if( residual > tolerance )
+   {
+      cerr << "Warning: interface iteration stopped after " << nIterations
+           << " iterations with relative residual " << residual
+           << " (tolerance " << tolerance << ")." << endl;
+   }
+
+   // recover interior unknowns: x_I = A_II^-1 ( b_I - A_IG x_G )
+   for( int p = 0; p < nP; p++ )
+   {
+      data[p].resize( coupled[p].size() );
+      for( size_t k = 0; k < coupled[p].size(); k++ )
+      {
+         data[p][k] = xG[ coupled[p][k] ];
+      }
+   }
+   broadcast( "back", data );
+
+   for( int p = 0; p < nP; p++ ) data[p].resize( interior[p].size() );
+   gather( data );
+
+   for( int p = 0; p < nP; p++ )
+   for( size_t k = 0; k < interior[p].size(); k++ )
+   {
+      xData[ interior[p][k] ] = data[p][k];
+   }
+   for( int i = 0; i < nG; i++ )
+   {
+      xData[ interface[i] ] = xG[i];
+   }
+}
+
+void DomainSolver :: applySchur( const vector<double>& v, vector<double>& w )
+// computes w = Sv, where S = A_GG - A_GI A_II^-1 A_IG
+{
+   int nP = workers.size();
+   vector< vector<double> > data( nP );
+
+   // start the workers first, so that they run while A_GG is applied here
+   for( int p = 0; p < nP; p++ )
+   {
+      data[p].resize( coupled[p].size() );
+      for( size_t k = 0; k < coupled[p].size(); k++ )
+      {
+         data[p][k] = v[ coupled[p][k] ];
+      }
+   }
+   broadcast( "schur", data );
+
+   w.assign( v.size(), 0. );
+   for( size_t k = 0; k < ggValue.size(); k++ )
+   {
+      int i = ggRow[k];
+      int j = ggCol[k];
+      w[i] += ggValue[k] * v[j];
+      if( i != j ) w[j] += ggValue[k] * v[i];
+   }
+
+   gather( data );
+   for( int p = 0; p < nP; p++ )
+   for( size_t k = 0; k < coupled[p].size(); k++ )
+   {
+      w[ coupled[p][k] ] -= data[p][k];
+   }
+}
+
+void DomainSolver :: broadcast( const char* command, const vector< vector<double> >& data )
+// sends a command followed by one block of data to every worker
+{
+   for( size_t p = 0; p < workers.size(); p++ )
+   {
+      if( !workers[p]->writeLine( command ) || !send( *workers[p], data[p] ))
+      {
+         stop();
+         throw Error( "lost connection to domain solver worker" );
+      }
+   }
+}
+
+void DomainSolver :: gather( vector< vector<double> >& data )
+// receives one block of data from every worker (the size of each
+// block is given by the current size of data[p])
+{
+   // read all replies before reporting an error, so that no worker
+   // is left blocked on a full connection
+   string error;
+   for( size_t p = 0; p < workers.size(); p++ )
+   {
+      string reply;
+      if( !workers[p]->readLine( reply ) ||
+          ( reply == "ok" && !receive( *workers[p], data[p], data[p].size() )))
+      {
+         error = "lost connection to domain solver worker";
+      }
+      else if( reply != "ok" )
+      {
+         error = reply;
+      }
+   }
+
+   if( !error.empty() )
+   {
+      stop();
+      throw Error( error );
+   }
+}
+
+int DomainSolver :: size( void ) const
+// returns the number of rows of A
+{
+   return n;
+}
+
+int DomainSolver :: nPatches( void ) const
+// returns the number of patches
+{
+   return workers.size();
+}
+
+int DomainSolver :: interfaceSize( void ) const
+// returns the number of rows on the interface
+{
+   return interface.size();
+}
+
+double DomainSolver :: nnz( void ) const
+// returns the total number of nonzeros in the interior factors
+{
+   return lnz;
+}
+
+static void solveInterior( Common& common, Factor& A, vector<double>& x, vector<double>& b )
+// solves A_II x = b (where A_II may be empty)
+{
+   x.resize( b.size() );
+   if( b.empty() )
+   {
+      return;
+   }
+
+   Dense X( common, &x[0], x.size() );
+   Dense B( common, &b[0], b.size() );
+   A.solve( X, B );
+}
+
+void DomainSolver :: work( Socket& master )
+// processes commands from the master process until it hangs up
+{
+   // the workers already run in parallel, and fork() leaves the thread
+   // pools of the master in an undefined state, so each worker uses a
+   // single thread
+   Common::setDefaultThreads( 1 );
+   Common common;
+
+   Factor A( common );
+   int nI = 0, nG = 0;
+   vector<int> bRow, bCol;
+   vector<double> bValue;
+   vector<double> bI, v, t, y, reply;
+
+   string line;
+   while( master.readLine( line ))
+   {
+      stringstream in( line );
+      string command;
+      in >> command;
+
+      if( command == "quit" )
+      {
+         return;
+      }
+
+      if( command == "factor" )
+      {
+         int nA = 0, nB = 0;
+         in >> nI >> nG >> nA >> nB;
+
+         vector<int> aRow, aCol;
+         vector<double> aValue;
+         if( !receive( master, aRow, nA ) || !receive( master, aCol, nA ) || !receive( master, aValue, nA ) ||
+             !receive( master, bRow, nB ) || !receive( master, bCol, nB ) || !receive( master, bValue, nB ))
+         {
+            return;
+         }
+
+         double nnz = 0.;
+         if( nI > 0 )
+         {
+            Upper A0( common, nI, nI );
+            for( int k = 0; k < nA; k++ )
+            {
+               A0( aRow[k], aCol[k] ) = aValue[k];
+            }
+            A.build( A0 );
+            nnz = A.nnz();
+
+            // (an interior block that is not positive-definite would make
+            // every later solve meaningless)
+            if( !A.succeeded() )
+            {
+               master.writeLine( "error couldn't factor the interior of a patch (not positive-definite)" );
+               continue;
+            }
+         }
+
+         stringstream out;
+         out << "ok " << nnz;
+         master.writeLine( out.str() );
+         continue;
+      }
+
+      if( command == "interior" || command == "schur" || command == "back" )
+      {
+         bool isInterior = command == "interior";
+         if( !receive( master, isInterior ? bI : v, isInterior ? nI : nG ))
+         {
+            return;
+         }
+
+         // t = b_I (interior), A_IG v (schur), or b_I - A_IG x_G (back)
+         if( command == "schur" ) t.assign( nI, 0. );
+         else t = bI;
+
+         if( !isInterior )
+         {
+            double sign = command == "back" ? -1. : 1.;
+            for( size_t k = 0; k < bValue.size(); k++ )
+            {
+               t[ bRow[k] ] += sign * bValue[k] * v[ bCol[k] ];
+            }
+         }
+
+         solveInterior( common, A, y, t );
+
+         if( command == "back" )
+         {
+            reply.swap( y );
+         }
+         else
+         {
+            // reply with A_GI y
+            reply.assign( nG, 0. );
+            for( size_t k = 0; k < bValue.size(); k++ )
+            {
+               reply[ bCol[k] ] += bValue[k] * y[ bRow[k] ];
+            }
+         }
+
+         if( !master.writeLine( "ok" ) || !send( master, reply ))
+         {
+            return;
+         }
+         continue;
+      }
+
+      master.writeLine( "error unknown command " + command );
+   }
+}
+
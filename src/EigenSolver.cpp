@@ -6,15 +6,24 @@
 
 #include "EigenSolver.h"
 #include "LinearSolver.h"
+#include "Utility.h"
 #include <cmath>
+#include <algorithm>
 
-void EigenSolver :: solve( Factor& A,
-                           vector<Quaternion>& x )
-// solves the eigenvalue problem Ax = cx for the
-// eigenvector x with the smallest eigenvalue c
+template <class Solver>
+void EigenSolver :: inverseIteration( Solver& A,
+                                      vector<Quaternion>& x,
+                                      bool warmStart )
+// solves the eigenvalue problem Ax = cx using any solver with the
+// interface of Factor (see LinearSolver)
 {
-   // set the initial guess to the identity
+   // set the initial guess to the identity, or to the
+   // previous solution if requested
    vector<Quaternion> b( x.size(), 1. );
+   if( warmStart && norm2( x ) > 0. )
+   {
+      b.swap( x );
+   }
 
    // perform a fixed number of inverse power iterations
    const int nIter = 3;
@@ -22,28 +31,197 @@ void EigenSolver :: solve( Factor& A,
    {
       normalize( b );
       LinearSolver::solve( A, x, b );
-      b = x;
+      b.swap( x ); // (the solution becomes the next right-hand side)
    }
 
    // normalize the final solution
+   x.swap( b );
+   normalize( x );
+}
+
+void EigenSolver :: solve( Factor& A,
+                           vector<Quaternion>& x,
+                           bool warmStart )
+// solves the eigenvalue problem Ax = cx for the
+// eigenvector x with the smallest eigenvalue c
+{
+   inverseIteration( A, x, warmStart );
+}
+
+void EigenSolver :: solve( DomainSolver& A,
+                           vector<Quaternion>& x,
+                           bool warmStart )
+// solves the eigenvalue problem Ax = cx using domain decomposition
+{
+   inverseIteration( A, x, warmStart );
+}
+
+int EigenSolver :: solve( const BlockMatrix& A,
+                          vector<Quaternion>& x,
+                          bool warmStart,
+                          double tolerance,
+                          int maxIterations )
+// solves the eigenvalue problem Ax = cx using LOBPCG
+{
+   // relative size below which a search direction is considered
+   // linearly dependent on the others
+   const double dependent = 1e-10;
+
+   int n = A.size( 1 );
+
+   // set the initial guess to the identity, or to the
+   // previous solution if requested
+   if( !warmStart || (int) x.size() != n || norm2( x ) == 0. )
+   {
+      x.assign( n, 1. );
+   }
+   normalize( x );
+
+   // build block-Jacobi preconditioner
+   vector<Quaternion> T;
+   A.getDiagonal( T );
+   for( int i = 0; i < n; i++ )
+   {
+      T[i] = T[i].norm2() > 0. ? T[i].inv() : Quaternion( 1. );
+   }
+
+   // basis vectors x, w and p, and their products with A
+   vector<Quaternion> Ax, w, Aw, p, Ap;
+   A.multiply( x, Ax );
+   double c = dot( x, Ax );
+
+   int iteration;
+   for( iteration = 0; iteration < maxIterations; iteration++ )
+   {
+      // compute preconditioned residual, and stop if converged
+      vector<Quaternion>& r( w );
+      r.resize( n );
+      for( int i = 0; i < n; i++ )
+      {
+         r[i] = Ax[i] - c*x[i];
+      }
+      if( norm2( r ) <= tolerance*tolerance * norm2( Ax ))
+      {
+         break;
+      }
+
+      for( int i = 0; i < n; i++ )
+      {
+         w[i] = T[i] * r[i];
+      }
+      A.multiply( w, Aw );
+
+      // orthonormalize the basis (applying the same operations to its
+      // products with A), dropping dependent directions
+      vector<Quaternion>*  V[3] = { &x,  &w,  &p  };
+      vector<Quaternion>* AV[3] = { &Ax, &Aw, &Ap };
+      int m = p.empty() ? 2 : 3;
+      int k = 1;
+      for( int j = 1; j < m; j++ )
+      {
+         vector<Quaternion>& v( *V[j] );
+         vector<Quaternion>& Av( *AV[j] );
+         double length0 = sqrt( norm2( v ));
+
+         for( int l = 0; l < k; l++ )
+         {
+            double a = dot( *V[l], v );
+            for( int i = 0; i < n; i++ )
+            {
+               v[i] -= a * (*V[l])[i];
+               Av[i] -= a * (*AV[l])[i];
+            }
+         }
+
+         double length = sqrt( norm2( v ));
+         if( length <= dependent * length0 || length == 0. )
+         {
+            continue;
+         }
+         for( int i = 0; i < n; i++ )
+         {
+            v[i] /= length;
+            Av[i] /= length;
+         }
+
+         swap( V[k], V[j] );
+         swap( AV[k], AV[j] );
+         k++;
+      }
+      m = k;
+
+      // minimize the Rayleigh quotient over the span of the basis
+      double G[9], values[3], vectors[9];
+      for( int a = 0; a < m; a++ )
+      for( int b = 0; b < m; b++ )
+      {
+         G[ a+m*b ] = .5 * ( dot( *V[a], *AV[b] ) + dot( *V[b], *AV[a] ));
+      }
+      symmetricEigen( m, G, values, vectors );
+
+      int smallest = 0;
+      for( int a = 1; a < m; a++ )
+      {
+         if( values[a] < values[smallest] ) smallest = a;
+      }
+      const double* y = &vectors[ m*smallest ];
+      c = values[ smallest ];
+
+      // the new search direction is the update of x, which becomes the
+      // combination of all basis vectors
+      vector<Quaternion> pNew( n, 0. ), ApNew( n, 0. );
+      for( int a = 1; a < m; a++ )
+      for( int i = 0; i < n; i++ )
+      {
+         pNew[i] += y[a] * (*V[a])[i];
+         ApNew[i] += y[a] * (*AV[a])[i];
+      }
+      for( int i = 0; i < n; i++ )
+      {
+         x[i] = y[0]*(*V[0])[i] + pNew[i];
+         Ax[i] = y[0]*(*AV[0])[i] + ApNew[i];
+      }
+      p.swap( pNew );
+      Ap.swap( ApNew );
+   }
+
    normalize( x );
+   return iteration;
 }
 
 void EigenSolver :: normalize( vector<Quaternion>& x )
 // rescales x to have unit length
 {
    // compute length
-   double norm = 0.;
+   double norm = sqrt( norm2( x ));
+
+   // normalize
    for( size_t i = 0; i < x.size(); i++ )
    {
-      norm += x[i].norm2();
+      x[i] /= norm;
    }
-   norm = sqrt( norm );
+}
 
-   // normalize
+double EigenSolver :: norm2( const vector<Quaternion>& x )
+// returns the squared length of x
+{
+   double sum = 0.;
    for( size_t i = 0; i < x.size(); i++ )
    {
-      x[i] /= norm;
+      sum += x[i].norm2();
+   }
+   return sum;
+}
+
+double EigenSolver :: dot( const vector<Quaternion>& x,
+                           const vector<Quaternion>& y )
+// returns the real inner product of x and y
+{
+   double sum = 0.;
+   for( size_t i = 0; i < x.size(); i++ )
+   {
+      sum += x[i].re()*y[i].re() + x[i].im()*y[i].im();
    }
+   return sum;
 }
 
@@ -0,0 +1,118 @@
+// =============================================================================
+// SpinXForm -- FileWatcher.cpp
+//
+
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include "FileWatcher.h"
+
+static time_t modificationTime( const string& filename )
+// returns the modification time of a file, or zero if it does not exist
+{
+   struct stat info;
+   if( stat( filename.c_str(), &info ) != 0 )
+   {
+      return 0;
+   }
+   return info.st_mtime;
+}
+
+FileWatcher :: FileWatcher( void )
+// creates a watcher that is not watching any file
+: fd( -1 ),
+  modified( 0 )
+{}
+
+FileWatcher :: ~FileWatcher( void )
+// stops watching
+{
+   close();
+}
+
+bool FileWatcher :: watch( const string& _filename )
+// starts watching the specified file
+{
+   close();
+
+   filename = _filename;
+   modified = modificationTime( filename );
+
+   size_t slash = filename.rfind( '/' );
+   string directory = slash == string::npos ? "." : filename.substr( 0, slash+1 );
+   name = slash == string::npos ? filename : filename.substr( slash+1 );
+
+#ifdef __linux__
+   // watch the directory rather than the file itself, since a file that is
+   // replaced by a rename gets a new inode (and the old watch goes stale)
+   fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+   if( fd < 0 )
+   {
+      return false;
+   }
+
+   if( inotify_add_watch( fd, directory.c_str(), IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE ) < 0 )
+   {
+      close();
+      return false;
+   }
+#endif
+
+   return modified != 0;
+}
+
+bool FileWatcher :: changed( void )
+// returns true if the file has changed since the last call
+{
+   bool result = false;
+
+#ifdef __linux__
+   if( fd < 0 )
+   {
+      return false;
+   }
+
+   // drain all pending events (the descriptor is nonblocking)
+   char buffer[ 4096 ] __attribute__(( aligned( __alignof__( struct inotify_event ))));
+   ssize_t length;
+   while(( length = read( fd, buffer, sizeof( buffer ))) > 0 )
+   {
+      for( char* p = buffer; p < buffer + length; )
+      {
+         const struct inotify_event* event = (const struct inotify_event*) p;
+         if( event->len > 0 && name == event->name )
+         {
+            result = true;
+         }
+         p += sizeof( struct inotify_event ) + event->len;
+      }
+   }
+#else
+   if( filename.empty() )
+   {
+      return false;
+   }
+
+   time_t t = modificationTime( filename );
+   if( t != modified )
+   {
+      modified = t;
+      result = true;
+   }
+#endif
+
+   return result;
+}
+
+void FileWatcher :: close( void )
+// stops watching
+{
+   if( fd >= 0 )
+   {
+      ::close( fd );
+   }
+   fd = -1;
+}
+
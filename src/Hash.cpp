@@ -0,0 +1,50 @@
+// =============================================================================
+// SpinXForm -- Hash.cpp
+//
+
+#include <cstdio>
+#include "Hash.h"
+
+// FNV-1a parameters (written in 32-bit halves, since C++98 has no
+// 64-bit literals)
+static const uint64_t offsetBasis = ((uint64_t) 0xcbf29ce4u << 32) | 0x84222325u;
+static const uint64_t prime       = ((uint64_t) 0x00000100u << 32) | 0x000001b3u;
+
+Hash :: Hash( void )
+// creates the hash of an empty stream
+: h( offsetBasis )
+{}
+
+Hash :: Hash( uint64_t seed )
+// creates the hash of an empty stream with a seeded initial state
+: h( offsetBasis )
+{
+   add( seed );
+}
+
+void Hash :: add( const void* data, size_t size )
+// appends "size" bytes to the stream
+{
+   const unsigned char* p = (const unsigned char*) data;
+   uint64_t x = h;
+   for( size_t i = 0; i < size; i++ )
+   {
+      x = ( x ^ p[i] ) * prime;
+   }
+   h = x;
+}
+
+uint64_t Hash :: value( void ) const
+// returns the hash of all bytes added so far
+{
+   return h;
+}
+
+std::string Hash :: hex( void ) const
+// returns the hash as 16 hexadecimal digits
+{
+   char s[17];
+   snprintf( s, sizeof(s), "%08x%08x", (unsigned int) ( h >> 32 ), (unsigned int) h );
+   return s;
+}
+
@@ -8,19 +8,82 @@
 #include <iostream>
 #include <cmath>
 #include <cstdlib>
+#include <cctype>
 #include "Image.h"
 #include "Utility.h"
+#include "Error.h"
 
-double& Image :: operator()( int x, int y )
-// accesses pixel (x,y)
+// pixels are stored in square tiles of tileSize x tileSize pixels
+static const int tileBits = 3;
+static const int tileSize = 1 << tileBits;
+static const int tileMask = tileSize - 1;
+
+// number of points sampled at once by average()
+static const int averageChunk = 256;
+
+Image :: Image( void )
+// creates an empty image
+: type( pixel8 ),
+  normalization( 1. ),
+  w( 0 ),
+  h( 0 ),
+  tilesX( 0 )
+{}
+
+void Image :: allocate( int width, int height, PixelType _type, double _normalization )
+// allocates (zeroed) tiled storage for a width x height image
+{
+   w = width;
+   h = height;
+   type = _type;
+   normalization = _normalization;
+
+   int bytesPerPixel = 1;
+   if( type == pixel16    ) bytesPerPixel = sizeof( unsigned short );
+   if( type == pixelFloat ) bytesPerPixel = sizeof( float );
+
+   tilesX = ( w + tileMask ) >> tileBits;
+   int tilesY = ( h + tileMask ) >> tileBits;
+   data.assign( (size_t) tilesX * tilesY * tileSize * tileSize * bytesPerPixel, 0 );
+
+   // discard any mip-maps of the previous contents
+   mipmaps.clear();
+   mipWidth.clear();
+   mipHeight.clear();
+}
+
+inline int Image :: index( int x, int y ) const
+// returns the position of pixel (x,y) in tiled storage
 {
-   return pixels[ x + y*w ];
+   int tile = ( x >> tileBits ) + ( y >> tileBits ) * tilesX;
+   return ( tile << ( 2*tileBits )) + ( x & tileMask ) + (( y & tileMask ) << tileBits );
 }
 
-const double& Image :: operator()( int x, int y ) const
-// accesses pixel (x,y)
+template <class T>
+T* Image :: pixelData( void )
+// returns storage as an array of the native pixel type
 {
-   return pixels[ x + y*w ];
+   return (T*) &data[0];
+}
+
+template <class T>
+const T* Image :: pixelData( void ) const
+// returns storage as an array of the native pixel type
+{
+   return (const T*) &data[0];
+}
+
+double Image :: operator()( int x, int y ) const
+// returns the value of pixel (x,y) in the range [0,1]
+{
+   int i = index( x, y );
+
+   switch( type )
+   {
+      case pixel8:  return normalization * pixelData<unsigned char >()[i];
+      case pixel16: return normalization * pixelData<unsigned short>()[i];
+      default:      return normalization * pixelData<float         >()[i];
+   }
 }
 
 double Image :: sample( double x, double y ) const
@@ -43,6 +106,229 @@ double Image :: sample( double x, double y ) const
           ay * ( bx * I(x0,y1) + ax * I(x1,y1) ) ;
 }
 
+void Image :: sample( int n, const double* x, const double* y, double* values ) const
+// samples image at n points (x[i],y[i]) using bilinear filtering
+{
+   switch( type )
+   {
+      case pixel8:  sampleBatch<unsigned char >( n, x, y, values ); break;
+      case pixel16: sampleBatch<unsigned short>( n, x, y, values ); break;
+      default:      sampleBatch<float         >( n, x, y, values ); break;
+   }
+}
+
+template <class T>
+void Image :: sampleBatch( int n, const double* x, const double* y, double* values ) const
+// samples n points using the native pixel type T; points are processed
+// in blocks so that the index computation and the filtering each run as
+// a separate loop that the compiler can vectorize
+{
+   const T* p = pixelData<T>();
+   const int blockSize = 256;
+
+   #pragma omp parallel for schedule( static ) if( n > 16*blockSize )
+   for( int b = 0; b < n; b += blockSize )
+   {
+      int m = min( blockSize, n-b );
+      int i00[ blockSize ], i10[ blockSize ], i01[ blockSize ], i11[ blockSize ];
+      double ax[ blockSize ], ay[ blockSize ];
+
+      // compute filter weights and (clamped) lookup positions
+      #pragma omp simd
+      for( int k = 0; k < m; k++ )
+      {
+         double fx = floor( x[b+k] );
+         double fy = floor( y[b+k] );
+         ax[k] = x[b+k] - fx;
+         ay[k] = y[b+k] - fy;
+
+         int x0 = max( 0, min( w-1, (int) fx     ));
+         int y0 = max( 0, min( h-1, (int) fy     ));
+         int x1 = max( 0, min( w-1, (int) fx + 1 ));
+         int y1 = max( 0, min( h-1, (int) fy + 1 ));
+
+         i00[k] = index( x0, y0 );
+         i10[k] = index( x1, y0 );
+         i01[k] = index( x0, y1 );
+         i11[k] = index( x1, y1 );
+      }
+
+      // gather pixels and blend
+      #pragma omp simd
+      for( int k = 0; k < m; k++ )
+      {
+         double bx = 1. - ax[k];
+         double by = 1. - ay[k];
+
+         values[b+k] = normalization *
+            ( by    * ( bx * p[i00[k]] + ax[k] * p[i10[k]] ) +
+              ay[k] * ( bx * p[i01[k]] + ax[k] * p[i11[k]] ));
+      }
+   }
+}
+
+void Image :: buildMipmaps( void ) const
+// builds the mip-map pyramid used by sampleFiltered(), unless it
+// has already been built
+{
+   if( !mipmaps.empty() || ( w <= 1 && h <= 1 ))
+   {
+      return;
+   }
+
+   int lw = w, lh = h; // dimensions of the previous level
+   while( lw > 1 || lh > 1 )
+   {
+      int nw = ( lw + 1 ) / 2;
+      int nh = ( lh + 1 ) / 2;
+      vector<float> level( nw*nh );
+
+      // average (clamped) 2x2 blocks of the previous level
+      int previous = mipmaps.size() - 1;
+      for( int y = 0; y < nh; y++ )
+      for( int x = 0; x < nw; x++ )
+      {
+         double sum = 0.;
+         for( int j = 0; j < 2; j++ )
+         for( int i = 0; i < 2; i++ )
+         {
+            int px = min( 2*x+i, lw-1 );
+            int py = min( 2*y+j, lh-1 );
+            if( previous < 0 ) sum += (*this)( px, py );
+            else               sum += mipmaps[previous][ px + py*lw ];
+         }
+         level[ x + y*nw ] = sum / 4.;
+      }
+
+      mipmaps.push_back( level );
+      mipWidth.push_back( nw );
+      mipHeight.push_back( nh );
+      lw = nw;
+      lh = nh;
+   }
+}
+
+double Image :: sampleLevel( int level, double x, double y ) const
+// samples mip-map level "level" at (x,y) using bilinear filtering,
+// where (x,y) is given in pixel coordinates of the full image
+{
+   if( level == 0 )
+   {
+      return sample( x, y );
+   }
+
+   // pixel i of level l covers full-resolution pixels [ i*2^l, (i+1)*2^l )
+   double s = (double) ( 1 << level );
+   x = ( x - .5*(s-1.) ) / s;
+   y = ( y - .5*(s-1.) ) / s;
+
+   const vector<float>& I( mipmaps[level-1] );
+   int lw = mipWidth[level-1];
+   int lh = mipHeight[level-1];
+
+   double ax = x - floor( x );
+   double ay = y - floor( y );
+   double bx = 1. - ax;
+   double by = 1. - ay;
+   int x0 = max( 0, min( lw-1, (int) floor( x )   ));
+   int y0 = max( 0, min( lh-1, (int) floor( y )   ));
+   int x1 = max( 0, min( lw-1, (int) floor( x )+1 ));
+   int y1 = max( 0, min( lh-1, (int) floor( y )+1 ));
+
+   return by * ( bx * I[x0+y0*lw] + ax * I[x1+y0*lw] ) +
+          ay * ( bx * I[x0+y1*lw] + ax * I[x1+y1*lw] ) ;
+}
+
+double Image :: sampleFiltered( double x, double y, double footprint ) const
+// samples image at (x,y) using trilinear mip-map filtering
+{
+   int nLevels = mipmaps.size() + 1;
+   double level = log( max( 1., footprint )) / log( 2. );
+   level = min( level, (double) ( nLevels-1 ));
+
+   // blend between the two nearest levels
+   int l0 = (int) floor( level );
+   int l1 = min( l0+1, nLevels-1 );
+   double t = level - l0;
+
+   double v0 = sampleLevel( l0, x, y );
+   if( t == 0. || l1 == l0 )
+   {
+      return v0;
+   }
+   return (1.-t) * v0 + t * sampleLevel( l1, x, y );
+}
+
+static double sumOfSamples( const Image& image, int n, const double* x, const double* y )
+// returns the sum of the image sampled at n points (at most averageChunk)
+{
+   double values[ averageChunk ];
+   image.sample( n, x, y, values );
+
+   double sum = 0.;
+   for( int i = 0; i < n; i++ )
+   {
+      sum += values[i];
+   }
+   return sum;
+}
+
+double Image :: average( const double x[3], const double y[3] ) const
+// approximates the average value of the (bilinearly interpolated) image
+// over the triangle with corners (x[i],y[i]); the triangle is split into
+// n^2 congruent subtriangles, and the image is sampled at the centroid of
+// each one.  The subtriangles are about a pixel across, but there are no
+// more of them than about twice the number of pixels the triangle covers
+// (so slivers are not oversampled), and n is at most maxSubdivision
+{
+   const int maxSubdivision = 1024;
+
+   double length = 0.;
+   for( int i = 0; i < 3; i++ )
+   {
+      int j = (i+1) % 3;
+      length = max( length, sqrt( sqr( x[j]-x[i] ) + sqr( y[j]-y[i] )));
+   }
+   double area = .5 * fabs( (x[1]-x[0])*(y[2]-y[0]) - (x[2]-x[0])*(y[1]-y[0]) );
+   double width = min( length, sqrt( 2.*area ));
+   int n = max( 1, (int) ceil( min( (double) maxSubdivision, width )));
+
+   // (points are sampled in fixed-size batches, so that no memory is
+   // allocated per triangle)
+   double px[ averageChunk ], py[ averageChunk ];
+   int m = 0;
+   double sum = 0.;
+   for( int i = 0; i < n; i++ )
+   for( int j = 0; i+j < n; j++ )
+   {
+      // centroid of the "upward" subtriangle at (i,j), plus the centroid
+      // of the "downward" subtriangle next to it (if any)
+      for( int k = 0; k < 2; k++ )
+      {
+         if( k == 1 && i+j == n-1 ) break;
+
+         double a = ( i + (k+1)/3. ) / n;
+         double b = ( j + (k+1)/3. ) / n;
+         px[m] = x[0] + a*(x[1]-x[0]) + b*(x[2]-x[0]);
+         py[m] = y[0] + a*(y[1]-y[0]) + b*(y[2]-y[0]);
+         m++;
+
+         if( m == averageChunk )
+         {
+            sum += sumOfSamples( *this, m, px, py );
+            m = 0;
+         }
+      }
+   }
+   if( m > 0 )
+   {
+      sum += sumOfSamples( *this, m, px, py );
+   }
+
+   // (there are n^2 subtriangles)
+   return sum / ( (double) n * n );
+}
+
 int Image :: width( void ) const
 // returns image width
 {
@@ -74,18 +360,40 @@ class TGAHeader
 };
 
 void Image :: read( const char* _filename )
-// loads an image file in Truevision TGA format
-// (must be uncompressed RGB image with 24 or 32 bits per pixel)
+// loads an image file in Truevision TGA, PGM, or PFM format
+// (must be a single-channel grayscale image)
 {
    filename = string( _filename );
    ifstream in( filename.c_str(), ios_base::binary );
 
    if( !in.is_open() )
    {
-      cerr << "Error: could not open file " << filename << " for input!" << endl;
-      exit( 1 );
+      throw Error( "could not open file " + filename + " for input" );
+   }
+
+   // determine format from the magic number (TGA files have none)
+   char magic[2] = { 0, 0 };
+   in.read( magic, 2 );
+   in.clear();
+   in.seekg( 0 );
+
+   if( magic[0] == 'P' && magic[1] == '5' )
+   {
+      readPGM( in );
+   }
+   else if( magic[0] == 'P' && ( magic[1] == 'f' || magic[1] == 'F' ))
+   {
+      readPFM( in );
+   }
+   else
+   {
+      readTGA( in );
    }
+}
 
+void Image :: readTGA( istream& in )
+// loads an uncompressed 8-bit grayscale TGA image
+{
    // read header
    TGAHeader header;
    in.read( (char*) &(header.idFieldSize),        1 );
@@ -110,16 +418,12 @@ void Image :: read( const char* _filename )
       swapShort( header.height );
    }
 
-   w = header.width;
-   h = header.height;
-
    // validate data type
    const char uncompressedGrayscale = 3;
    if( header.dataTypeCode != uncompressedGrayscale ||
        header.bitsPerPixel != 8 )
    {
-      cerr << "Error: input must be uncompressed grayscale image with 8 bits per pixel." << endl;
-      exit( 1 );
+      throw Error( "input must be uncompressed grayscale image with 8 bits per pixel" );
    }
 
    // read identification field (unused)
@@ -136,14 +440,130 @@ void Image :: read( const char* _filename )
    }
 
    // read pixel data
-   vector<unsigned char> pixelData( w*h );
-   in.read( (char*) &pixelData[0], w*h );
+   allocate( header.width, header.height, pixel8, 1./255. );
+   vector<unsigned char> fileData( w*h );
+   in.read( (char*) &fileData[0], w*h );
+   if( in.gcount() != (streamsize) ( w*h ))
+   {
+      throw Error( "truncated pixel data in " + filename );
+   }
+
+   // copy pixel data into tiles
+   unsigned char* p = pixelData<unsigned char>();
+   for( int y = 0; y < h; y++ )
+   for( int x = 0; x < w; x++ )
+   {
+      p[ index( x, y ) ] = fileData[ x + y*w ];
+   }
+}
 
-   // convert pixel data
-   pixels.resize( w*h );
-   for( int i = 0; i < w*h; i++ )
+static void skipHeaderSpace( istream& in )
+// skips whitespace and comments in a PGM/PFM header
+{
+   while( in.good() )
    {
-      pixels[i] = (double) pixelData[i] / 255.;
+      int c = in.peek();
+      if( c == '#' )
+      {
+         string comment;
+         getline( in, comment );
+      }
+      else if( isspace( c ))
+      {
+         in.get();
+      }
+      else
+      {
+         break;
+      }
+   }
+}
+
+void Image :: readPGM( istream& in )
+// loads a binary (P5) PGM image with 8 or 16 bits per pixel
+{
+   string magic;
+   int width, height, maxValue;
+   in >> magic;
+   skipHeaderSpace( in ); in >> width;
+   skipHeaderSpace( in ); in >> height;
+   skipHeaderSpace( in ); in >> maxValue;
+   in.get(); // single whitespace character before the pixel data
+
+   if( !in.good() || width <= 0 || height <= 0 || maxValue <= 0 || maxValue > 65535 )
+   {
+      throw Error( "malformed PGM header in " + filename );
+   }
+
+   // read pixel data (16-bit samples are stored most significant byte first)
+   int bytesPerPixel = maxValue < 256 ? 1 : 2;
+   allocate( width, height, bytesPerPixel == 1 ? pixel8 : pixel16, 1./maxValue );
+   vector<unsigned char> fileData( w*h*bytesPerPixel );
+   in.read( (char*) &fileData[0], fileData.size() );
+   if( in.gcount() != (streamsize) fileData.size() )
+   {
+      throw Error( "truncated pixel data in " + filename );
+   }
+
+   // copy pixel data into tiles; PGM rows run top to bottom,
+   // whereas row zero is the bottom row everywhere else
+   for( int y = 0; y < h; y++ )
+   for( int x = 0; x < w; x++ )
+   {
+      int i = x + (h-1-y)*w;
+      if( bytesPerPixel == 1 )
+      {
+         pixelData<unsigned char>()[ index( x, y ) ] = fileData[i];
+      }
+      else
+      {
+         pixelData<unsigned short>()[ index( x, y ) ] =
+            ( fileData[2*i] << 8 ) | fileData[2*i+1];
+      }
+   }
+}
+
+void Image :: readPFM( istream& in )
+// loads a grayscale (Pf) PFM image with 32-bit float pixels
+{
+   string magic;
+   int width, height;
+   double scale;
+   in >> magic >> width >> height >> scale;
+   in.get(); // single whitespace character before the pixel data
+
+   if( magic != "Pf" )
+   {
+      throw Error( "input must be a grayscale (Pf) PFM image" );
+   }
+
+   if( !in.good() || width <= 0 || height <= 0 )
+   {
+      throw Error( "malformed PFM header in " + filename );
+   }
+
+   // read pixel data (a negative scale indicates little-endian data;
+   // rows run bottom to top, as in TGA)
+   allocate( width, height, pixelFloat, 1. );
+   vector<float> fileData( w*h );
+   in.read( (char*) &fileData[0], w*h*sizeof(float) );
+   if( in.gcount() != (streamsize) ( w*h*sizeof(float) ))
+   {
+      throw Error( "truncated pixel data in " + filename );
+   }
+
+   // copy pixel data into tiles
+   bool swapBytes = ( scale < 0. ) == bigEndian();
+   float* p = pixelData<float>();
+   for( int y = 0; y < h; y++ )
+   for( int x = 0; x < w; x++ )
+   {
+      float value = fileData[ x + y*w ];
+      if( swapBytes )
+      {
+         swapFloat( value );
+      }
+      p[ index( x, y ) ] = value;
    }
 }
 
@@ -153,6 +573,12 @@ void Image :: reload( void )
    read( filename.c_str() );
 }
 
+const string& Image :: source( void ) const
+// returns the name of the file the image was read from
+{
+   return filename;
+}
+
 void Image :: clamp( int& x, int& y ) const
 // clamps coordinates to range [0,w-1] x [0,h-1]
 {
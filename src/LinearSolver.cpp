@@ -5,51 +5,65 @@
 //
 
 #include "LinearSolver.h"
+#include <cassert>
 
+// CHOLMOD environment for code without an environment of its own: the
+// Dense wrappers in solveReal() (which only describe existing storage, so
+// CHOLMOD never allocates through this environment there) and
+// QuaternionMatrix objects created by the default constructor.  Meshes and
+// their matrices use the environment of the mesh
 cm::Common cc;
 
+// quaternions must be stored as four consecutive doubles in order for their
+// storage to be used directly as a real vector (see also Quaternion.h)
+typedef char QuaternionLayoutCheck[ sizeof( Quaternion ) == 4*sizeof( double ) ? 1 : -1 ];
+
+template <class Solver>
+static void solveReal( Solver& A,
+                       vector<Quaternion>& x,
+                       const vector<Quaternion>& b )
+// solves the linear system Ax = b using any solver with the interface
+// of Factor (i.e., size() and solve( Dense&, Dense& ))
+{
+   int n = A.size() / 4;
+   assert( (int) b.size() >= n );
+   assert( &x != &b );
+   x.resize( n );
+
+   // wrap quaternion storage as real vectors (CHOLMOD does not modify
+   // the right-hand side, so casting away const is safe)
+   Dense result( cc, LinearSolver::toReal( x ), n*4 );
+   Dense    rhs( cc, const_cast<double*>( LinearSolver::toReal( b )), n*4 );
+
+   // solve real linear system
+   A.solve( result, rhs );
+}
+
 void LinearSolver :: solve( Factor& A,
                      vector<Quaternion>& x,
                      const vector<Quaternion>& b )
 // solves the linear system Ax = b where A is positive-semidefinite
 {
-   int n = x.size();
-   Dense result( cc, n*4, 1 );
-   Dense    rhs( cc, n*4, 1 );
-
-   // convert right-hand side to real values
-   toReal( b, rhs );
-
-   // solve real linear system
-   result = cholmod_l_solve( CHOLMOD_A, *A, *rhs, cc );
+   solveReal( A, x, b );
+}
 
-   // convert solution back to quaternions
-   toQuat( result, x );
+void LinearSolver :: solve( DomainSolver& A,
+                     vector<Quaternion>& x,
+                     const vector<Quaternion>& b )
+// solves the linear system Ax = b using domain decomposition
+{
+   solveReal( A, x, b );
 }
 
-void LinearSolver :: toReal( const vector<Quaternion>& uQuat,
-                             Dense& uReal )
-// converts vector from quaternion- to real-valued entries
+double* LinearSolver :: toReal( vector<Quaternion>& u )
+// returns the entries of u as a real vector
 {
-   for( size_t i = 0; i < uQuat.size(); i++ )
-   {
-      uReal(i*4+0) = uQuat[i].re();   // real
-      uReal(i*4+1) = uQuat[i].im().x; // i
-      uReal(i*4+2) = uQuat[i].im().y; // j
-      uReal(i*4+3) = uQuat[i].im().z; // k
-   }
+   return reinterpret_cast<double*>( &u[0] );
 }
 
-void LinearSolver :: toQuat( const Dense& uReal,
-                             vector<Quaternion>& uQuat )
-// converts vector from real- to quaternion-valued entries
+const double* LinearSolver :: toReal( const vector<Quaternion>& u )
+// returns the entries of u as a real vector
 {
-   for( size_t i = 0; i < uQuat.size(); i++ )
-   {
-      uQuat[i] = Quaternion( uReal(i*4+0),  // real
-                             uReal(i*4+1),  // i
-                             uReal(i*4+2),  // j
-                             uReal(i*4+3)); // k
-   }
+   return reinterpret_cast<const double*>( &u[0] );
 }
 
@@ -0,0 +1,82 @@
+// =============================================================================
+// SpinXForm -- MappedFile.cpp
+//
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "MappedFile.h"
+
+MappedFile :: MappedFile( void )
+// creates an empty mapping
+: address( NULL ),
+  length( 0 )
+{}
+
+MappedFile :: ~MappedFile( void )
+// releases the mapping, if any
+{
+   close();
+}
+
+bool MappedFile :: open( const string& filename )
+// maps the specified file into memory; returns false on failure
+{
+   close();
+
+   int fd = ::open( filename.c_str(), O_RDONLY );
+   if( fd < 0 )
+   {
+      return false;
+   }
+
+   struct stat info;
+   if( fstat( fd, &info ) != 0 )
+   {
+      ::close( fd );
+      return false;
+   }
+
+   length = info.st_size;
+   if( length > 0 )
+   {
+      void* p = mmap( NULL, length, PROT_READ, MAP_PRIVATE, fd, 0 );
+      if( p == MAP_FAILED )
+      {
+         ::close( fd );
+         length = 0;
+         return false;
+      }
+      address = p;
+   }
+
+   // the mapping remains valid after the descriptor is closed
+   ::close( fd );
+   return true;
+}
+
+void MappedFile :: close( void )
+// releases the mapping
+{
+   if( address )
+   {
+      munmap( address, length );
+   }
+
+   address = NULL;
+   length = 0;
+}
+
+const void* MappedFile :: data( void ) const
+// returns a pointer to the first byte of the file
+{
+   return address;
+}
+
+size_t MappedFile :: size( void ) const
+// returns the size of the file in bytes
+{
+   return length;
+}
+
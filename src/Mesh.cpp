@@ -7,276 +7,1864 @@
 #include <fstream>
 #include <sstream>
 #include <cmath>
+#include <algorithm>
 #include "Mesh.h"
 #include "LinearSolver.h"
 #include "EigenSolver.h"
 #include "Utility.h"
+#include "MappedFile.h"
+#include "BlockMatrix.h"
+#include "Hash.h"
 
-extern cm::Common cc;
 Mesh :: Mesh( void )
 // default constructor
-: L( cc ), E( cc ) // give matrices a handle to the CHOLMOD environment "cc"
+: verbose( true ),
+  warmStart( false ),
+  cancelled( NULL ),
+  factorTime( 0. ),
+  eigensolveTime( 0. ),
+  poissonTime( 0. ),
+  L( common ), E( common ), // give matrices a handle to the CHOLMOD environment of this mesh
+  poissonConstraint( constrainPin ),
+  nPoissonIterations( 0 ),
+  poissonResidual( 0. ),
+  E0( common ),
+  eigensolver( eigensolveInverse ),
+  nEigenIterations( 0 ),
+  laplacianMemory( 0 ),
+  nLowRankUpdates( 0 ),
+  factorOrdering( Factor::orderDefault ),
+  factorMode( Factor::modeAuto ),
+  nPatches( 1 ),
+  resultCache( NULL )
 {}
 
+Mesh :: ~Mesh( void )
+// destructor
+{
+   clearComponents();
+}
+
 void Mesh :: updateDeformation( void )
 {
-   int t0 = clock();
+   double t0 = wallClock();
+
+   string key;
+   ResultCache::Signature signature;
+   if( resultCache && !warmStart )
+   {
+      key = resultKey( signature );
+      if( resultCache->fetch( key, signature, newPositions ))
+      {
+         if( verbose )
+         {
+            cout << "time: " << wallClock()-t0 << "s (cached result)" << endl;
+         }
+         return;
+      }
+   }
+
+   if( components.empty() )
+   {
+      computeDeformation();
+   }
+   else
+   {
+      solveComponents();
+   }
+   if( cancelled && cancelled() )
+   {
+      return;
+   }
+   normalizeSolution();
+
+   if( !key.empty() && !resultCache->store( key, signature, newPositions ))
+   {
+      cerr << "Warning: couldn't store result in cache." << endl;
+   }
+
+   double t1 = wallClock();
+
+   if( verbose )
+   {
+      cout << "time: " << t1-t0 << "s";
+      cout << " (factor: " << factorTime << "s, eigensolve: " << eigensolveTime << "s, Poisson: " << poissonTime << "s)" << endl;
+   }
+}
+
+void Mesh :: computeDeformation( void )
+// computes the (unnormalized) deformation of a connected mesh, and
+// records the time spent in each stage
+{
+   double t0 = wallClock();
+
+   // solve eigenvalue problem for local similarity transformation lambda
+   buildEigenvalueProblem();
+   double t1 = wallClock();
+   if( eigensolver == eigensolveLOBPCG )
+   {
+      nEigenIterations = EigenSolver::solve( Eblock, lambda, warmStart );
+   }
+   else if( domainE.nPatches() > 0 )
+   {
+      EigenSolver::solve( domainE, lambda, warmStart );
+   }
+   else
+   {
+      EigenSolver::solve( E, lambda, warmStart );
+   }
+   double t2 = wallClock();
+   factorTime = t1-t0;
+   eigensolveTime = t2-t1;
+   poissonTime = 0.;
+
+   // (the result may no longer be needed)
+   if( cancelled && cancelled() )
+   {
+      return;
+   }
+
+   // solve Poisson problem for new vertex positions
+   buildPoissonProblem();
+   solvePoissonProblem();
+
+   double t3 = wallClock();
+   poissonTime = t3-t2;
+}
+
+int Mesh :: nComponents( void ) const
+// returns the number of connected components of the mesh
+{
+   return components.empty() ? 1 : components.size();
+}
+
+void Mesh :: resetDeformation( void )
+{
+   // copy original mesh vertices to current mesh
+   for( size_t i = 0; i < vertices.size(); i++ )
+   {
+      newPositions[ i*3+0 ] = vertices[i].im().x;
+      newPositions[ i*3+1 ] = vertices[i].im().y;
+      newPositions[ i*3+2 ] = vertices[i].im().z;
+   }
+
+   normalizeSolution();
+}
+
+void Mesh :: setCurvatureChange( const Image& image, const double scale,
+                                 CurvatureSampling sampling )
+// sets rho values by interpreting "image" as a square image
+// in the range [0,1] x [0,1] and mapping values to the
+// surface via vertex texture coordinates -- grayscale
+// values in the  range [0,1] get mapped (linearly) to values
+// in the range [-scale,scale]
+{
+   double w = (double) image.width();
+   double h = (double) image.height();
+   int nF = faces.size();
+
+   // gather texture coordinates of all face corners
+   vector<double> x( 3*nF ), y( 3*nF ), values( 3*nF );
+   for( int i = 0; i < nF; i++ )
+   for( int j = 0; j < 3; j++ )
+   {
+      const Vector& uv = faces[i].uv[j];
+      x[i*3+j] = uv.x*w;
+      y[i*3+j] = uv.y*h;
+   }
+
+   if( sampling == sampleCorners )
+   {
+      // sample the image at all corners at once
+      if( nF > 0 )
+      {
+         image.sample( 3*nF, &x[0], &y[0], &values[0] );
+      }
+
+      for( int i = 0; i < nF; i++ )
+      {
+         rho[i] = ( values[i*3+0] + values[i*3+1] + values[i*3+2] ) / 3.;
+      }
+   }
+   else
+   {
+      if( sampling == sampleMipmap )
+      {
+         image.buildMipmaps();
+      }
+
+      #pragma omp parallel for schedule( dynamic, 64 )
+      for( int i = 0; i < nF; i++ )
+      {
+         const double* xi = &x[i*3];
+         const double* yi = &y[i*3];
+
+         if( sampling == sampleArea )
+         {
+            rho[i] = image.average( xi, yi );
+         }
+         else
+         {
+            // filter over a square with the same area as the triangle
+            double area = .5 * fabs( (xi[1]-xi[0])*(yi[2]-yi[0]) -
+                                     (xi[2]-xi[0])*(yi[1]-yi[0]) );
+            rho[i] = image.sampleFiltered( ( xi[0] + xi[1] + xi[2] ) / 3.,
+                                           ( yi[0] + yi[1] + yi[2] ) / 3.,
+                                           sqrt( area ));
+         }
+      }
+   }
+
+   // map values to range [-scale,scale]
+   for( int i = 0; i < nF; i++ )
+   {
+      rho[i] = (2.*(rho[i]-.5)) * scale;
+   }
+}
+
+void Mesh :: setCurvatureChange( const double* values, const double scale )
+// sets rho values directly from an array containing one value
+// per face (in the face order of the original file), multiplied
+// by "scale"
+{
+   for( size_t i = 0; i < faces.size(); i++ )
+   {
+      rho[i] = scale * values[ originalFace[i] ];
+   }
+}
+
+void Mesh :: setCurvatureChange( const float* values, const double scale )
+// sets rho values directly from an array containing one value
+// per face (in the face order of the original file), multiplied
+// by "scale"
+{
+   for( size_t i = 0; i < faces.size(); i++ )
+   {
+      rho[i] = scale * (double) values[ originalFace[i] ];
+   }
+}
+
+bool Mesh :: readCurvatureChange( const string& filename, const double scale )
+// sets rho values from a raw binary file containing one double or
+// one float per face (determined by the file size), multiplied by "scale"
+{
+   MappedFile file;
+   if( !file.open( filename ))
+   {
+      cerr << "Error: couldn't open file ";
+      cerr << filename;
+      cerr << " for input!" << endl;
+      return false;
+   }
+
+   size_t nF = faces.size();
+   if( file.size() == nF*sizeof(double) )
+   {
+      setCurvatureChange( (const double*) file.data(), scale );
+   }
+   else if( file.size() == nF*sizeof(float) )
+   {
+      setCurvatureChange( (const float*) file.data(), scale );
+   }
+   else
+   {
+      cerr << "Error: " << filename << " must contain one double or one float per face!" << endl;
+      return false;
+   }
+
+   return true;
+}
+
+double Mesh :: area( int i ) const
+// returns area of triangle i in the original mesh
+{
+   return faceAreas[i];
+}
+
+double Mesh :: cotan( int i, int j ) const
+// returns cotangent of the angle at corner j of triangle i
+// in the original mesh
+{
+   return cotangents[ i*3+j ];
+}
+
+const Quaternion& Mesh :: edgeVector( int i, int j ) const
+// returns the edge vector of triangle i across from corner j
+// in the original mesh (as an imaginary quaternion)
+{
+   return edgeVectors[ i*3+j ];
+}
+
+void Mesh :: reorder( VertexOrdering ordering )
+// renumbers vertices according to the specified ordering, and sorts
+// faces by their vertices
+{
+   int nV = vertices.size();
+   int nF = faces.size();
+
+   // compute new vertex order as a list of current indices
+   vector<int> order;
+   if( ordering == orderRCM )
+   {
+      buildGeometry();
+      buildConnectivity();
+      reverseCuthillMcKee( order );
+   }
+   else
+   {
+      mortonOrder( order );
+   }
+
+   // renumber vertices
+   vector<int> newIndex( nV );
+   vector<int> oldOriginal( originalVertex );
+   vector<Quaternion> oldVertices( vertices );
+   for( int i = 0; i < nV; i++ )
+   {
+      newIndex[ order[i] ] = i;
+      vertices[i] = oldVertices[ order[i] ];
+      originalVertex[i] = oldOriginal[ order[i] ];
+   }
+
+   for( int i = 0; i < nF; i++ )
+   for( int j = 0; j < 3; j++ )
+   {
+      faces[i].vertex[j] = newIndex[ faces[i].vertex[j] ];
+   }
+
+   // sort faces by their smallest and largest vertex index
+   vector< pair< pair<int,int>, int > > keys( nF );
+   for( int i = 0; i < nF; i++ )
+   {
+      const int* v = faces[i].vertex;
+      keys[i] = make_pair( make_pair( min( v[0], min( v[1], v[2] )),
+                                      max( v[0], max( v[1], v[2] ))), i );
+   }
+   sort( keys.begin(), keys.end() );
+
+   vector<Face> oldFaces( faces );
+   vector<int> oldOriginalFace( originalFace );
+   for( int i = 0; i < nF; i++ )
+   {
+      faces[i] = oldFaces[ keys[i].second ];
+      originalFace[i] = oldOriginalFace[ keys[i].second ];
+   }
+}
+
+void Mesh :: reverseCuthillMcKee( vector<int>& order ) const
+// computes a reverse Cuthill-McKee ordering of the vertices, which
+// places adjacent vertices close together; requires buildConnectivity()
+{
+   int nV = vertices.size();
+   vector<bool> visited( nV, false );
+   vector<int> depth( nV, -1 );
+   order.clear();
+   order.reserve( nV );
+
+   // visit each connected component, starting with low-degree vertices
+   vector< pair<int,int> > candidates( nV );
+   for( int i = 0; i < nV; i++ )
+   {
+      candidates[i] = make_pair( nNeighbors( i ), i );
+   }
+   sort( candidates.begin(), candidates.end() );
+
+   for( int c = 0; c < nV; c++ )
+   {
+      if( visited[ candidates[c].second ] ) continue;
+
+      // breadth-first search from a vertex far from the rest of the
+      // component, visiting neighbors in order of increasing degree
+      size_t head = order.size();
+      int root = peripheralVertex( candidates[c].second, depth );
+      order.push_back( root );
+      visited[ root ] = true;
+
+      vector< pair<int,int> > next;
+      for( ; head < order.size(); head++ )
+      {
+         int i = order[head];
+
+         next.clear();
+         for( int k = 0; k < nNeighbors( i ); k++ )
+         {
+            int j = neighbor( i, k );
+            if( !visited[j] )
+            {
+               visited[j] = true;
+               next.push_back( make_pair( nNeighbors( j ), j ));
+            }
+         }
+         sort( next.begin(), next.end() );
+
+         for( size_t k = 0; k < next.size(); k++ )
+         {
+            order.push_back( next[k].second );
+         }
+      }
+   }
+
+   reverse( order.begin(), order.end() );
+}
+
+int Mesh :: peripheralVertex( int root, vector<int>& depth ) const
+// finds a pseudo-peripheral vertex in the component of the given root
+// by repeatedly moving to a lowest-degree vertex in the last level of
+// a breadth-first search; "depth" is scratch space with one entry per
+// vertex, which must equal -1 on input (and does so again on output)
+{
+   int bestDepth = -1;
+
+   for( int iteration = 0; iteration < 4; iteration++ )
+   {
+      depth[ root ] = 0;
+
+      vector<int> queue( 1, root );
+      for( size_t head = 0; head < queue.size(); head++ )
+      {
+         int i = queue[head];
+         for( int k = 0; k < nNeighbors( i ); k++ )
+         {
+            int j = neighbor( i, k );
+            if( depth[j] == -1 )
+            {
+               depth[j] = depth[i] + 1;
+               queue.push_back( j );
+            }
+         }
+      }
+
+      // find a lowest-degree vertex in the last level
+      int lastDepth = depth[ queue.back() ];
+      int next = queue.back();
+      for( int k = queue.size()-1; k >= 0 && depth[ queue[k] ] == lastDepth; k-- )
+      {
+         if( nNeighbors( queue[k] ) < nNeighbors( next ))
+         {
+            next = queue[k];
+         }
+      }
+
+      for( size_t k = 0; k < queue.size(); k++ )
+      {
+         depth[ queue[k] ] = -1;
+      }
+
+      // stop once the eccentricity no longer increases
+      if( lastDepth <= bestDepth ) break;
+      bestDepth = lastDepth;
+      root = next;
+   }
+
+   return root;
+}
+
+void Mesh :: mortonOrder( vector<int>& order ) const
+// orders vertices along a Morton (Z-order) curve through their
+// positions, using 10 bits per coordinate
+{
+   int nV = vertices.size();
+
+   // find bounding box
+   Vector cMin = vertices[0].im();
+   Vector cMax = vertices[0].im();
+   for( int i = 0; i < nV; i++ )
+   {
+      const Vector& p( vertices[i].im() );
+      for( int k = 0; k < 3; k++ )
+      {
+         cMin[k] = min( cMin[k], p[k] );
+         cMax[k] = max( cMax[k], p[k] );
+      }
+   }
+
+   // interleave bits of quantized coordinates
+   vector< pair<unsigned int,int> > keys( nV );
+   for( int i = 0; i < nV; i++ )
+   {
+      const Vector& p( vertices[i].im() );
+
+      unsigned int q[3];
+      for( int k = 0; k < 3; k++ )
+      {
+         double extent = cMax[k] - cMin[k];
+         double t = extent > 0. ? ( p[k] - cMin[k] ) / extent : 0.;
+         q[k] = (unsigned int) min( 1023., t*1024. );
+      }
+
+      unsigned int key = 0;
+      for( int b = 9; b >= 0; b-- )
+      for( int k = 0; k < 3; k++ )
+      {
+         key = ( key << 1 ) | (( q[k] >> b ) & 1 );
+      }
+
+      keys[i] = make_pair( key, i );
+   }
+   sort( keys.begin(), keys.end() );
+
+   order.resize( nV );
+   for( int i = 0; i < nV; i++ )
+   {
+      order[i] = keys[i].second;
+   }
+}
+
+void Mesh :: buildGeometry( void )
+// precomputes areas, corner cotangents, and edge vectors of the
+// original mesh, which are reused by every assembly pass
+{
+   int nF = faces.size();
+   faceAreas.resize( nF );
+   cotangents.resize( 3*nF );
+   edgeVectors.resize( 3*nF );
+
+   #pragma omp parallel for
+   for( int i = 0; i < nF; i++ )
+   {
+      const int* v = faces[i].vertex;
+
+      // compute edges across from each vertex
+      for( int j = 0; j < 3; j++ )
+      {
+         edgeVectors[ i*3+j ] = vertices[ v[ (j+2) % 3 ]] -
+                                vertices[ v[ (j+1) % 3 ]] ;
+      }
+
+      // compute cotangent of the angle at each vertex
+      // (equal to cosine over sine, which equals the dot
+      // product over the norm of the cross product)
+      for( int j = 0; j < 3; j++ )
+      {
+         Vector u1 = vertices[ v[ (j+1) % 3 ]].im() - vertices[ v[j] ].im();
+         Vector u2 = vertices[ v[ (j+2) % 3 ]].im() - vertices[ v[j] ].im();
+         cotangents[ i*3+j ] = (u1*u2)/(u1^u2).norm();
+      }
+
+      // compute area
+      Vector& p1 = vertices[ v[0] ].im();
+      Vector& p2 = vertices[ v[1] ].im();
+      Vector& p3 = vertices[ v[2] ].im();
+      faceAreas[i] = .5 * (( p2-p1 ) ^ ( p3-p1 )).norm();
+   }
+}
+
+void Mesh :: buildConnectivity( void )
+// builds the list of unique edges (with cotangent weights) and the
+// vertex-to-vertex adjacency; requires buildGeometry()
+{
+   int nV = vertices.size();
+   int nF = faces.size();
+
+   // sort corners by the (unordered) edge across from them
+   vector< pair< pair<int,int>, int > > corners( 3*nF );
+   for( int i = 0; i < nF; i++ )
+   for( int j = 0; j < 3; j++ )
+   {
+      int a = faces[i].vertex[ (j+1) % 3 ];
+      int b = faces[i].vertex[ (j+2) % 3 ];
+      corners[ i*3+j ] = make_pair( make_pair( min( a, b ), max( a, b )), i*3+j );
+   }
+   sort( corners.begin(), corners.end() );
+
+   // merge corners across from the same edge
+   edges.clear();
+   vector<int> nEdgeFaces;
+   for( size_t k = 0; k < corners.size(); k++ )
+   {
+      int i = corners[k].second / 3;
+      int j = corners[k].second % 3;
+
+      if( k == 0 || corners[k].first != corners[k-1].first )
+      {
+         Edge edge;
+         edge.vertex[0] = corners[k].first.first;
+         edge.vertex[1] = corners[k].first.second;
+         edge.face[0] = edge.face[1] = -1;
+         edge.weight = 0.;
+         edges.push_back( edge );
+         nEdgeFaces.push_back( 0 );
+      }
+
+      Edge& edge( edges.back() );
+      int& n( nEdgeFaces.back() );
+      if( n < 2 )
+      {
+         edge.face[n] = i;
+      }
+      edge.weight += cotan( i, j ) / 2.;
+      n++;
+   }
+
+   // count neighbors of each vertex
+   int nE = edges.size();
+   adjacencyStart.assign( nV+1, 0 );
+   for( int e = 0; e < nE; e++ )
+   {
+      adjacencyStart[ edges[e].vertex[0]+1 ]++;
+      adjacencyStart[ edges[e].vertex[1]+1 ]++;
+   }
+   for( int i = 0; i < nV; i++ )
+   {
+      adjacencyStart[i+1] += adjacencyStart[i];
+   }
+
+   // fill in neighbors (in increasing order, since edges are sorted)
+   adjacency.resize( 2*nE );
+   adjacentEdges.resize( 2*nE );
+   vector<int> next( adjacencyStart.begin(), adjacencyStart.end()-1 );
+   for( int e = 0; e < nE; e++ )
+   {
+      int a = edges[e].vertex[0];
+      int b = edges[e].vertex[1];
+
+      adjacency[ next[a] ] = b; adjacentEdges[ next[a] ] = e; next[a]++;
+      adjacency[ next[b] ] = a; adjacentEdges[ next[b] ] = e; next[b]++;
+   }
+
+   // mark vertices on edges with only one adjacent face
+   boundaryVertices.assign( nV, false );
+   for( int e = 0; e < nE; e++ )
+   {
+      if( nEdgeFaces[e] == 1 )
+      {
+         boundaryVertices[ edges[e].vertex[0] ] = true;
+         boundaryVertices[ edges[e].vertex[1] ] = true;
+      }
+   }
+}
+
+int Mesh :: nNeighbors( int i ) const
+// returns the number of vertices adjacent to vertex i
+{
+   return adjacencyStart[i+1] - adjacencyStart[i];
+}
+
+int Mesh :: neighbor( int i, int k ) const
+// returns the kth vertex adjacent to vertex i
+{
+   return adjacency[ adjacencyStart[i] + k ];
+}
+
+int Mesh :: neighborEdge( int i, int k ) const
+// returns the index of the edge between vertex i and its
+// kth neighbor
+{
+   return adjacentEdges[ adjacencyStart[i] + k ];
+}
+
+bool Mesh :: isBoundary( int i ) const
+// returns true if vertex i is on the boundary
+{
+   return boundaryVertices[i];
+}
+
+static int findRoot( vector<int>& parent, int i )
+// returns the representative of the set containing i (union-find)
+{
+   while( parent[i] != i )
+   {
+      parent[i] = parent[ parent[i] ]; // path halving
+      i = parent[i];
+   }
+   return i;
+}
+
+int Mesh :: findComponents( void )
+// finds the connected components of the mesh, and lists the vertices
+// and faces of each component (sorted by decreasing number of faces);
+// vertices that do not belong to any face are ignored
+{
+   int nV = vertices.size();
+   int nF = faces.size();
+
+   // merge the endpoints of every edge
+   vector<int> parent( nV );
+   for( int i = 0; i < nV; i++ ) parent[i] = i;
+   for( size_t e = 0; e < edges.size(); e++ )
+   {
+      int a = findRoot( parent, edges[e].vertex[0] );
+      int b = findRoot( parent, edges[e].vertex[1] );
+      if( a != b ) parent[ max( a, b ) ] = min( a, b );
+   }
+
+   // number the components (in order of their first vertex)
+   vector<int> label( nV, -1 );
+   int nC = 0;
+   for( int i = 0; i < nV; i++ )
+   {
+      if( nNeighbors( i ) == 0 ) continue;
+
+      int r = findRoot( parent, i );
+      if( label[r] < 0 ) label[r] = nC++;
+   }
+
+   componentVertices.clear();
+   componentFaces.clear();
+   if( nC < 2 )
+   {
+      return nC;
+   }
+
+   vector< vector<int> > vertexLists( nC ), faceLists( nC );
+   for( int i = 0; i < nV; i++ )
+   {
+      if( nNeighbors( i ) > 0 ) vertexLists[ label[ findRoot( parent, i ) ]].push_back( i );
+   }
+   for( int k = 0; k < nF; k++ )
+   {
+      faceLists[ label[ findRoot( parent, faces[k].vertex[0] ) ]].push_back( k );
+   }
+
+   // put the largest components first, so that they are started first
+   vector< pair<int,int> > order( nC );
+   for( int c = 0; c < nC; c++ ) order[c] = make_pair( -(int) faceLists[c].size(), c );
+   sort( order.begin(), order.end() );
+
+   componentVertices.resize( nC );
+   componentFaces.resize( nC );
+   for( int c = 0; c < nC; c++ )
+   {
+      componentVertices[c].swap( vertexLists[ order[c].second ] );
+      componentFaces[c].swap( faceLists[ order[c].second ] );
+   }
+
+   return nC;
+}
+
+void Mesh :: buildComponents( void )
+// creates an independent mesh for each connected component
+{
+   int nC = componentVertices.size();
+   vector<int> local( vertices.size(), -1 );
+
+   for( int c = 0; c < nC; c++ )
+   {
+      vector<int>& v( componentVertices[c] );
+      vector<int>& f( componentFaces[c] );
+      int n = v.size();
+      int m = f.size();
+
+      // gather positions and faces, numbering vertices within the component
+      vector<double> positions( 3*n );
+      for( int i = 0; i < n; i++ )
+      {
+         const Vector& p( vertices[ v[i] ].im() );
+         positions[ i*3+0 ] = p.x;
+         positions[ i*3+1 ] = p.y;
+         positions[ i*3+2 ] = p.z;
+         local[ v[i] ] = i;
+      }
+
+      vector<int> indices( 3*m );
+      for( int k = 0; k < m; k++ )
+      for( int j = 0; j < 3; j++ )
+      {
+         indices[ k*3+j ] = local[ faces[ f[k] ].vertex[j] ];
+      }
+
+      Mesh* component = new Mesh;
+      components.push_back( component );
+      component->verbose = false;
+      component->setFactorOrdering( factorOrdering, factorMode );
+      component->poissonConstraint = poissonConstraint;
+      component->eigensolver = eigensolver;
+      component->nPatches = max( 1, (int) floor( (double) nPatches * n / vertices.size() + .5 ));
+      component->build( &positions[0], n, &indices[0], m );
+
+      // list vertices and faces in the order used by the component
+      vector<int> vOld( v ), fOld( f );
+      for( int i = 0; i < n; i++ ) v[i] = vOld[ component->originalVertex[i] ];
+      for( int k = 0; k < m; k++ ) f[k] = fOld[ component->originalFace[k] ];
+   }
+}
+
+void Mesh :: clearComponents( void )
+// releases the meshes of all connected components
+{
+   for( size_t c = 0; c < components.size(); c++ )
+   {
+      delete components[c];
+   }
+   components.clear();
+   componentVertices.clear();
+   componentFaces.clear();
+}
+
+void Mesh :: solveComponents( void )
+// deforms each connected component independently (in parallel), and
+// merges the results
+{
+   int nC = components.size();
+
+   // pass on the current values of rho
+   for( int c = 0; c < nC; c++ )
+   {
+      Mesh& component( *components[c] );
+      const vector<int>& f( componentFaces[c] );
+      for( size_t k = 0; k < f.size(); k++ )
+      {
+         component.rho[k] = rho[ f[k] ];
+      }
+      component.warmStart = warmStart;
+      component.cancelled = cancelled;
+   }
+
+   // split the threads among the components rather than letting each
+   // component's CHOLMOD environment (each component has its own) start
+   // as many threads as the whole mesh would: up to one thread per
+   // component, each component limited to its share
+   int nT = Common::threads();
+   for( int c = 0; c < nC; c++ )
+   {
+      components[c]->common.limitThreads( max( 1, nT/nC ));
+   }
+
+   #pragma omp parallel for schedule( dynamic, 1 ) num_threads( min( nC, nT ))
+   for( int c = 0; c < nC; c++ )
+   {
+      components[c]->computeDeformation();
+   }
+
+   // (keep the previous deformation if some components were skipped)
+   if( cancelled && cancelled() )
+   {
+      return;
+   }
+
+   factorTime = eigensolveTime = poissonTime = 0.;
+   for( int c = 0; c < nC; c++ )
+   {
+      const Mesh& component( *components[c] );
+      const vector<int>& v( componentVertices[c] );
+      int n = v.size();
+
+      factorTime += component.factorTime;
+      eigensolveTime += component.eigensolveTime;
+      poissonTime += component.poissonTime;
+
+      // each component is determined only up to translation and scale,
+      // so keep its original centroid and surface area
+      Vector c0( 0., 0., 0. ), c1( 0., 0., 0. );
+      for( int i = 0; i < n; i++ )
+      {
+         c0 += component.vertices[i].im();
+         c1 += component.newVertex( i );
+      }
+      c0 /= (double) n;
+      c1 /= (double) n;
+
+      double A0 = 0., A1 = 0.;
+      for( size_t k = 0; k < component.faces.size(); k++ )
+      {
+         const Face& face( component.faces[k] );
+         Vector p0 = component.newVertex( face.vertex[0] );
+         Vector p1 = component.newVertex( face.vertex[1] );
+         Vector p2 = component.newVertex( face.vertex[2] );
+         A0 += component.area( k );
+         A1 += (( p1-p0 ) ^ ( p2-p0 )).norm() / 2.;
+      }
+      double scale = A1 > 0. ? sqrt( A0 / A1 ) : 1.;
+
+      for( int i = 0; i < n; i++ )
+      {
+         Vector p = c0 + scale * ( component.newVertex( i ) - c1 );
+         newPositions[ v[i]*3+0 ] = p.x;
+         newPositions[ v[i]*3+1 ] = p.y;
+         newPositions[ v[i]*3+2 ] = p.z;
+      }
+   }
+}
+
+void Mesh :: setFactorOrdering( Factor::Ordering ordering, Factor::Mode mode )
+// selects the fill-reducing ordering and factorization mode for the
+// Laplace and eigenvalue matrices
+{
+   factorOrdering = ordering;
+   factorMode = mode;
+   L.setOrdering( ordering, mode );
+   E.setOrdering( ordering, mode );
+
+   for( size_t c = 0; c < components.size(); c++ )
+   {
+      components[c]->setFactorOrdering( ordering, mode );
+   }
+}
+
+void Mesh :: setEigensolver( Eigensolver method )
+// selects how the eigenvalue problem is solved
+{
+   eigensolver = method;
+   rhoFactored.clear();
+
+   for( size_t c = 0; c < components.size(); c++ )
+   {
+      components[c]->setEigensolver( method );
+   }
+}
+
+void Mesh :: setResultCache( ResultCache* cache )
+// looks up and stores deformations in the specified cache
+{
+   resultCache = cache;
+}
+
+string Mesh :: resultKey( ResultCache::Signature& signature ) const
+// returns the key of the current deformation in the result cache
+{
+   // (the check hashes the same inputs, but starts from a different state)
+   const uint64_t checkSeed = 1;
+
+   Hash key, check( checkSeed );
+   hashInputs( key );
+   hashInputs( check );
+
+   signature.nVertices = vertices.size();
+   signature.nFaces = faces.size();
+   signature.check = check.value();
+
+   return key.hex();
+}
+
+void Mesh :: hashInputs( Hash& hash ) const
+// adds everything the deformation depends on to a hash
+{
+   // geometry (in the internal vertex order, which also determines the
+   // order of newPositions) and connectivity
+   hash.add( vertices );
+   hash.add( faces.size() );
+   for( size_t i = 0; i < faces.size(); i++ )
+   {
+      hash.add( faces[i].vertex, sizeof( faces[i].vertex ));
+   }
+
+   // curvature change
+   hash.add( rho );
+
+   // solver settings (including those that only affect roundoff)
+   hash.add( (int) poissonConstraint );
+   hash.add( (int) eigensolver );
+   hash.add( (int) factorOrdering );
+   hash.add( (int) factorMode );
+   hash.add( nPatches );
+}
+
+void Mesh :: setDomainDecomposition( int _nPatches )
+// splits the Laplace and eigenvalue problems into nPatches patches
+{
+   nPatches = max( 1, _nPatches );
+}
+
+class CoordinateOrder
+// orders vertices by one of their coordinates
+{
+   public:
+      CoordinateOrder( const vector<Quaternion>& _vertices, int _axis )
+      : vertices( _vertices ), axis( _axis )
+      {}
+
+      bool operator()( int i, int j ) const
+      {
+         return vertices[i].im()[axis] < vertices[j].im()[axis];
+      }
+
+   protected:
+      const vector<Quaternion>& vertices;
+      int axis;
+};
+
+static void bisect( const vector<Quaternion>& vertices,
+                    vector<int>::iterator begin, vector<int>::iterator end,
+                    int firstPatch, int nPatches, vector<int>& patch )
+// assigns the vertices in [begin,end) to patches firstPatch, ...,
+// firstPatch+nPatches-1 by recursively splitting them along the longest
+// side of their bounding box, in proportion to the number of patches
+// on either side
+{
+   if( nPatches == 1 || end - begin <= 1 )
+   {
+      for( vector<int>::iterator i = begin; i != end; i++ )
+      {
+         patch[ *i ] = firstPatch;
+      }
+      return;
+   }
+
+   // find longest side of bounding box
+   Vector cMin = vertices[ *begin ].im();
+   Vector cMax = vertices[ *begin ].im();
+   for( vector<int>::iterator i = begin; i != end; i++ )
+   {
+      const Vector& p( vertices[ *i ].im() );
+      for( int k = 0; k < 3; k++ )
+      {
+         cMin[k] = min( cMin[k], p[k] );
+         cMax[k] = max( cMax[k], p[k] );
+      }
+   }
+   int axis = 0;
+   for( int k = 1; k < 3; k++ )
+   {
+      if( cMax[k] - cMin[k] > cMax[axis] - cMin[axis] ) axis = k;
+   }
+
+   // split at the corresponding quantile
+   int nLeft = nPatches / 2;
+   vector<int>::iterator middle = begin + (long) ( end - begin ) * nLeft / nPatches;
+   nth_element( begin, middle, end, CoordinateOrder( vertices, axis ));
+
+   bisect( vertices, begin, middle, firstPatch, nLeft, patch );
+   bisect( vertices, middle, end, firstPatch+nLeft, nPatches-nLeft, patch );
+}
+
+void Mesh :: partitionVertices( void )
+// assigns each vertex to one of nPatches patches of roughly equal size
+// via recursive coordinate bisection
+{
+   int nV = vertices.size();
+   vector<int> order( nV );
+   for( int i = 0; i < nV; i++ ) order[i] = i;
+
+   vertexPatch.resize( nV );
+   bisect( vertices, order.begin(), order.end(), 0, nPatches, vertexPatch );
+}
+
+void Mesh :: rowPatches( int nVertices, vector<int>& patch ) const
+// lists the patch of each row of a real matrix whose 4x4 blocks
+// correspond to the first nVertices vertices
+{
+   patch.resize( 4*nVertices );
+   for( int i = 0; i < nVertices; i++ )
+   for( int k = 0; k < 4; k++ )
+   {
+      patch[ 4*i+k ] = vertexPatch[i];
+   }
+}
+
+void Mesh :: printFactorStatistics( void )
+// prints the number of nonzeros, the flop count, and the estimated
+// reciprocal condition number of each factor, as well as the number of
+// iterations and the residual of the last Poisson solve
+{
+   if( !components.empty() )
+   {
+      cout << "connected components: " << components.size() << endl;
+      for( size_t c = 0; c < components.size(); c++ )
+      {
+         cout << "component " << c << " (" << components[c]->faces.size() << " faces):" << endl;
+         components[c]->printFactorStatistics();
+      }
+      return;
+   }
+
+   const double MB = 1024.*1024.;
+   cout << "assembly: peak " << laplacianMemory/MB << " MB (Laplacian), "
+        << E0.peakMemory()/MB << " MB (eigenvalue problem)" << endl;
+
+   if( !rhoFactored.empty() )
+   {
+      double eigenvalue, residual;
+      checkEigenvector( eigenvalue, residual );
+      cout << "eigenvector: Rayleigh quotient = " << eigenvalue << ", relative residual = " << residual << endl;
+   }
+
+   if( eigensolver == eigensolveLOBPCG )
+   {
+      cout << "eigenvalue problem: LOBPCG, " << nEigenIterations << " iterations, "
+           << Eblock.nBlocks() << " nonzero blocks" << endl;
+   }
+
+   if( domainL.nPatches() > 0 )
+   {
+      DomainSolver* solvers[2] = { &domainL, &domainE };
+      const char* names[2] = { "Laplacian", "eigenvalue problem" };
+      cout << "domain decomposition: " << nPatches << " patches" << endl;
+      for( int k = 0; k < 2; k++ )
+      {
+         if( solvers[k]->nPatches() == 0 ) continue;
+         cout << names[k] << ": interface rows = " << solvers[k]->interfaceSize()
+              << ", nnz(L) = " << solvers[k]->nnz() << " (patch interiors)"
+              << ", last solve: " << solvers[k]->nIterations << " iterations"
+              << ", relative residual = " << solvers[k]->residual << endl;
+      }
+      cout << "Poisson solve: " << nPoissonIterations << " solve(s), relative residual = " << poissonResidual << endl;
+      return;
+   }
+
+   cout << "Laplacian: nnz(L) = " << L.nnz() << ", flops = " << L.flops() << ", rcond = " << L.rcond()
+        << ( L.sharedAnalysis() ? " (shared analysis)" : "" ) << endl;
+   if( eigensolver == eigensolveInverse )
+   {
+      cout << "eigenvalue problem: nnz(L) = " << E.nnz() << ", flops = " << E.flops() << ", rcond = " << E.rcond()
+           << ( E.sharedAnalysis() ? " (shared analysis)" : "" ) << endl;
+   }
+   cout << "Poisson solve: " << nPoissonIterations << " solve(s), relative residual = " << poissonResidual << endl;
+}
+
+void Mesh :: checkEigenvector( double& eigenvalue, double& residual ) const
+// computes the Rayleigh quotient c = x'Ex/x'x of the current local
+// similarity transformation x, and the relative residual |Ex-cx|/|Ex|
+{
+   // (the block form of E0 is much cheaper to build and apply than
+   // its real expansion)
+   BlockMatrix E1( E0 );
+   vector<Quaternion> y;
+   E1.multiply( lambda, y );
+
+   int nV = vertices.size();
+   double xx = 0., xy = 0.;
+   for( int i = 0; i < nV; i++ )
+   {
+      xx += lambda[i].norm2();
+      xy += lambda[i].re()*y[i].re() + lambda[i].im()*y[i].im();
+   }
+   eigenvalue = xx > 0. ? xy / xx : 0.;
+
+   double rr = 0., yy = 0.;
+   for( int i = 0; i < nV; i++ )
+   {
+      rr += ( y[i] - eigenvalue*lambda[i] ).norm2();
+      yy += y[i].norm2();
+   }
+   residual = yy > 0. ? sqrt( rr / yy ) : 0.;
+}
+
+void Mesh :: setPoissonConstraint( PoissonConstraint constraint )
+// selects how the translational degree of freedom of the Poisson
+// problem for vertex positions is removed
+{
+   poissonConstraint = constraint;
+
+   for( size_t c = 0; c < components.size(); c++ )
+   {
+      components[c]->setPoissonConstraint( constraint );
+   }
+
+   if( !vertices.empty() && components.empty() )
+   {
+      buildLaplacian();
+   }
+}
+
+void Mesh :: setBoundaryConstraints( Factor& A, int nVertices )
+// places the rows of boundary vertices (among the first nVertices
+// vertices) in the last constraint set of A, for use with CAMD
+{
+   vector<SuiteSparse_long> constraints( 4*nVertices, 0 );
+   for( int i = 0; i < nVertices; i++ )
+   {
+      if( isBoundary( i ))
+      {
+         for( int k = 0; k < 4; k++ )
+         {
+            constraints[ 4*i+k ] = 1;
+         }
+      }
+   }
+
+   A.setConstraints( constraints );
+}
+
+void Mesh :: buildEigenvalueProblem( void )
+// builds and factors the matrix for the eigenvalue problem; if rho changed
+// on only a small number of faces since E was last factored, only the
+// affected matrix entries are updated, and the factorization is modified
+// via low-rank updates (or numerically refactored, reusing the symbolic
+// analysis) rather than being rebuilt
+{
+   // fraction of faces up to which low-rank updates are used
+   const double maxUpdateFraction = .01;
+
+   // number of low-rank updates before refactoring (to limit roundoff)
+   const int maxLowRankUpdates = 100;
+
+   int nV = vertices.size();
+   int nF = faces.size();
+
+   // (with domain decomposition, the matrix is always rebuilt, and
+   // each worker refactors its patch)
+   bool lobpcg = eigensolver == eigensolveLOBPCG;
+   bool domain = !lobpcg && domainE.nPatches() > 0;
+   if( rhoFactored.size() != rho.size() || ( domain && rho != rhoFactored ))
+   {
+      // allocate a sparse |V|x|V| matrix
+      E0.resize( nV, nV );
+
+      // visit each face
+      for( int k = 0; k < nF; k++ )
+      {
+         double A = area(k);
+         double a = -1. / (4.*A);
+         double b = rho[k] / 6.;
+         double c = A*rho[k]*rho[k] / 9.;
+
+         addEigenvalueTerms( k, a, b, c );
+      }
+
+      // build Cholesky factorization (keeping explicit zeros, so that
+      // the nonzero pattern does not depend on rho), or just the block
+      // matrix for LOBPCG
+      if( lobpcg )
+      {
+         Eblock.build( E0 );
+      }
+      else if( domain )
+      {
+         vector<int> patch;
+         rowPatches( nV, patch );
+         domainE.build( E0.toReal( true ), patch );
+      }
+      else
+      {
+         setBoundaryConstraints( E, nV );
+         E.build( E0.toReal( true ), connectivityKey + " E" );
+      }
+      rhoFactored = rho;
+      nLowRankUpdates = 0;
+      return;
+   }
+
+   // find faces where rho changed
+   vector<int> changed;
+   for( int k = 0; k < nF; k++ )
+   {
+      if( rho[k] != rhoFactored[k] )
+      {
+         changed.push_back( k );
+      }
+   }
+
+   if( changed.empty() )
+   {
+      return;
+   }
+
+   // update matrix entries around changed faces (the term that does
+   // not depend on rho cancels)
+   for( size_t i = 0; i < changed.size(); i++ )
+   {
+      int k = changed[i];
+      double A = area(k);
+      double b = ( rho[k] - rhoFactored[k] ) / 6.;
+      double c = A*( rho[k]*rho[k] - rhoFactored[k]*rhoFactored[k] ) / 9.;
+
+      addEigenvalueTerms( k, 0., b, c );
+   }
+
+   if( lobpcg )
+   {
+      Eblock.build( E0 );
+      rhoFactored = rho;
+      return;
+   }
+
+   // update factorization
+   bool updated = false;
+   if( changed.size() <= maxUpdateFraction * nF &&
+       nLowRankUpdates < maxLowRankUpdates )
+   {
+      updated = updateEigenvalueProblem( changed );
+      nLowRankUpdates++;
+   }
+
+   if( !updated )
+   {
+      E.refactor( E0.toReal( true ));
+      nLowRankUpdates = 0;
+   }
+
+   rhoFactored = rho;
+}
+
+void Mesh :: addEigenvalueTerms( int k, double a, double b, double c )
+// adds a*e_i*e_j + b*(e_j-e_i) + c to entry (i,j) of E0 for each ordered
+// pair of vertices i, j of face k, where e_i is the edge across from i
+{
+   // get vertex indices
+   int I[3] =
+   {
+      faces[k].vertex[0],
+      faces[k].vertex[1],
+      faces[k].vertex[2]
+   };
+
+   // get edges across from each vertex
+   const Quaternion* e = &edgeVectors[ k*3 ];
+
+   // increment matrix entry for each ordered pair of vertices
+   for( int i = 0; i < 3; i++ )
+   for( int j = 0; j < 3; j++ )
+   {
+      E0(I[i],I[j]) += a*e[i]*e[j] + b*(e[j]-e[i]) + c;
+   }
+}
+
+bool Mesh :: updateEigenvalueProblem( const vector<int>& changed )
+// applies the change in E due to a change of rho on the specified faces
+// to the factorization of E via low-rank updates and downdates; the change
+// on each face is a symmetric 12x12 block, which is split into positive
+// and negative parts via its eigendecomposition
+{
+   const int n = 12;
+   vector<double> values( n*changed.size() );
+   vector<double> vectors( n*n*changed.size() );
+   int nPlus = 0, nMinus = 0;
+
+   for( size_t f = 0; f < changed.size(); f++ )
+   {
+      int k = changed[f];
+      double A = area(k);
+      double b = ( rho[k] - rhoFactored[k] ) / 6.;
+      double c = A*( rho[k]*rho[k] - rhoFactored[k]*rhoFactored[k] ) / 9.;
+
+      // get edges across from each vertex
+      const Quaternion* e = &edgeVectors[ k*3 ];
+
+      // build real 12x12 matrix of changes
+      double M[n*n];
+      for( int i = 0; i < 3; i++ )
+      for( int j = 0; j < 3; j++ )
+      {
+         double Q[4][4];
+         Quaternion q = b*(e[j]-e[i]) + c;
+         q.toMatrix( Q );
+
+         for( int u = 0; u < 4; u++ )
+         for( int v = 0; v < 4; v++ )
+         {
+            M[ (i*4+u) + n*(j*4+v) ] = Q[u][v];
+         }
+      }
+
+      symmetricEigen( n, M, &values[n*f], &vectors[n*n*f] );
+
+      for( int i = 0; i < n; i++ )
+      {
+         if( values[n*f+i] > 0. ) nPlus++;
+         if( values[n*f+i] < 0. ) nMinus++;
+      }
+   }
+
+   // build update (C+) and downdate (C-) matrices such that the
+   // change in E equals C+ C+' - C- C-'
+   int nR = 4*vertices.size();
+   Sparse Cplus( common, nR, nPlus ), Cminus( common, nR, nMinus );
+   int iPlus = 0, iMinus = 0;
+   for( size_t f = 0; f < changed.size(); f++ )
+   {
+      int k = changed[f];
+      for( int i = 0; i < n; i++ )
+      {
+         double lambda = values[n*f+i];
+         if( lambda == 0. ) continue;
+
+         Sparse& C( lambda > 0. ? Cplus : Cminus );
+         int& column( lambda > 0. ? iPlus : iMinus );
+         double s = sqrt( fabs( lambda ));
+
+         for( int r = 0; r < n; r++ )
+         {
+            double x = vectors[ n*n*f + r + n*i ];
+            if( x != 0. )
+            {
+               C( 4*faces[k].vertex[r/4] + r%4, column ) = s*x;
+            }
+         }
+         column++;
+      }
+   }
+
+   // apply updates before downdates, to stay positive-definite
+   bool ok = true;
+   if( nPlus  > 0 ) ok = ok && E.updown( Cplus,  true  );
+   if( nMinus > 0 ) ok = ok && E.updown( Cminus, false );
+   return ok;
+}
+
+void Mesh :: buildPoissonProblem( void )
+{
+   buildOmega();
+}
 
-   // solve eigenvalue problem for local similarity transformation lambda
-   buildEigenvalueProblem();
-   EigenSolver::solve( E, lambda );
+void Mesh :: solvePoissonProblem( void )
+// solves Lx = omega for the new vertex positions x, which are written
+// directly into newPositions
+{
+   // maximum number of refinement steps and relative tolerance
+   // for the shifted formulation
+   const int maxIterations = 50;
+   const double tolerance = 1e-12;
 
-   // solve Poisson problem for new vertex positions
-   // (we assume the final degree of freedom equals zero
-   // in order to get a strictly positive-definite matrix)
-   buildPoissonProblem();
    int nV = vertices.size();
-   vector<Quaternion> v( nV-1 );
-   LinearSolver::solve( L, v, omega );
-   for( int i = 0; i < nV-1; i++ )
+
+   // project right-hand side onto the range of L (vectors with
+   // zero mean), which makes the system consistent; omega is
+   // modified in place and then passed to the solver without copying
+   vector<Quaternion>& b( omega );
+   vector<Quaternion>& x( poissonSolution );
+   removeMean( b );
+
+   double bNorm2 = 0.;
+   for( int i = 0; i < nV; i++ ) bNorm2 += b[i].im().norm2();
+
+   // when the final degree of freedom is pinned, L has only nV-1 rows and
+   // the solver ignores the last entry of b; we assume that this degree
+   // of freedom equals zero in order to get a strictly positive-definite
+   // matrix
+   solveLaplacian( x, b );
+   x.resize( nV, 0. );
+   setPositions( x );
+   nPoissonIterations = 1;
+
+   // record relative residual (translations are in the kernel of L,
+   // so all formulations can be compared directly); the shifted
+   // matrix only approximates L, so that solution is refined iteratively
+   vector<double> r( 3*nV );
+   vector<Quaternion> rQuat;
+   while( true )
+   {
+      applyLaplacian( newPositions, r );
+
+      double rNorm2 = 0.;
+      for( int i = 0; i < nV; i++ )
+      {
+         const Vector& bi( b[i].im() );
+         for( int k = 0; k < 3; k++ )
+         {
+            r[ i*3+k ] = bi[k] - r[ i*3+k ];
+            rNorm2 += r[ i*3+k ] * r[ i*3+k ];
+         }
+      }
+      poissonResidual = bNorm2 > 0. ? sqrt( rNorm2 / bNorm2 ) : 0.;
+
+      if( poissonConstraint != constrainShift ||
+          rNorm2 <= tolerance*tolerance*bNorm2 ||
+          nPoissonIterations == maxIterations )
+      {
+         break;
+      }
+
+      rQuat.resize( nV );
+      for( int i = 0; i < nV; i++ )
+      {
+         rQuat[i] = Quaternion( 0., r[ i*3+0 ], r[ i*3+1 ], r[ i*3+2 ] );
+      }
+
+      solveLaplacian( x, rQuat );
+      setPositions( x, true );
+      nPoissonIterations++;
+   }
+}
+
+void Mesh :: solveLaplacian( vector<Quaternion>& x, const vector<Quaternion>& b )
+// solves Lx = b according to the Poisson constraint: with the mean-zero
+// constraint, the bordered system
+//
+//    [ L  1 ] [ x  ]   [ b ]
+//    [ 1' 0 ] [ mu ] = [ 0 ]
+//
+// is solved by splitting off the final vertex a, whose row and column are
+// omitted from the factored (pinned) Laplacian L_p: with B = [ l 1 ], where
+// l is the final column of L, the unknowns z = ( x_a, mu ) solve the 2x2
+// Schur complement system S z = ( b_a - l'y, -1'y ), where y = L_p^-1 b and
+// S = [ L_aa 1; 1 0 ] - B' L_p^-1 B, and the remaining unknowns are then
+// y - L_p^-1 B z.  Otherwise the factored matrix is simply applied
+{
+   if( poissonConstraint != constrainMeanZero )
    {
-      newVertices[i] = v[i];
+      solvePinned( x, b );
+      return;
+   }
+
+   int n = vertices.size() - 1;
+   solvePinned( x, b );
+
+   Quaternion r[2] = { b[n], 0. };
+   for( int i = 0; i < n; i++ )
+   {
+      r[0] -= borderColumn[i] * x[i];
+      r[1] -= x[i];
    }
-   newVertices[nV-1] = 0.;
-   normalizeSolution();
 
-   int t1 = clock();
-   cout << "time: " << (t1-t0)/(double) CLOCKS_PER_SEC << "s" << endl;
+   Quaternion z[2];
+   for( int k = 0; k < 2; k++ )
+   {
+      z[k] = borderInverse[k][0]*r[0] + borderInverse[k][1]*r[1];
+   }
+
+   for( int i = 0; i < n; i++ )
+   {
+      x[i] -= borderW[0][i]*z[0] + borderW[1][i]*z[1];
+   }
+   x.resize( n+1 );
+   x[n] = z[0];
 }
 
-void Mesh :: resetDeformation( void )
+void Mesh :: solvePinned( vector<Quaternion>& x, const vector<Quaternion>& b )
+// solves Lx = b using either the factorization of L or domain decomposition
 {
-   // copy original mesh vertices to current mesh
-   for( size_t i = 0; i < vertices.size(); i++ )
+   if( domainL.nPatches() > 0 )
    {
-      newVertices[i] = vertices[i];
+      LinearSolver::solve( domainL, x, b );
    }
+   else
+   {
+      LinearSolver::solve( L, x, b );
+   }
+}
 
-   normalizeSolution();
+void Mesh :: setPositions( const vector<Quaternion>& x, bool accumulate )
+// copies the imaginary parts of x into newPositions (or adds them,
+// if "accumulate" is true)
+{
+   int nV = vertices.size();
+
+   #pragma omp parallel for
+   for( int i = 0; i < nV; i++ )
+   {
+      const Vector& xi( x[i].im() );
+      double* p = &newPositions[ i*3 ];
+      if( accumulate )
+      {
+         p[0] += xi.x;
+         p[1] += xi.y;
+         p[2] += xi.z;
+      }
+      else
+      {
+         p[0] = xi.x;
+         p[1] = xi.y;
+         p[2] = xi.z;
+      }
+   }
 }
 
-void Mesh :: setCurvatureChange( const Image& image, const double scale )
-// sets rho values by interpreting "image" as a square image
-// in the range [0,1] x [0,1] and mapping values to the
-// surface via vertex texture coordinates -- grayscale
-// values in the  range [0,1] get mapped (linearly) to values
-// in the range [-scale,scale]
+void Mesh :: applyLaplacian( const vector<double>& x, vector<double>& y ) const
+// computes y = Lx for vertex coordinates x (three per vertex), where L is
+// the (full, unshifted) cotan-Laplace operator
 {
-   double w = (double) image.width();
-   double h = (double) image.height();
+   int nV = vertices.size();
 
-   for( size_t i = 0; i < faces.size(); i++ )
+   #pragma omp parallel for
+   for( int i = 0; i < nV; i++ )
    {
-      // get handle to current value of rho
-      rho[i] = 0.;
+      double* yi = &y[ i*3 ];
+      yi[0] = yi[1] = yi[2] = 0.;
 
-      // compute average value over the face
-      for( int j = 0; j < 3; j++ )
+      for( int k = adjacencyStart[i]; k < adjacencyStart[i+1]; k++ )
       {
-         Vector uv = faces[i].uv[j];
-         rho[i] += image.sample( uv.x*w, uv.y*h ) / 3.;
+         double w = edges[ adjacentEdges[k] ].weight;
+         const double* xj = &x[ adjacency[k]*3 ];
+         yi[0] += w * ( x[ i*3+0 ] - xj[0] );
+         yi[1] += w * ( x[ i*3+1 ] - xj[1] );
+         yi[2] += w * ( x[ i*3+2 ] - xj[2] );
       }
-
-      // map value to range [-scale,scale]
-      rho[i] = (2.*(rho[i]-.5)) * scale;
    }
 }
 
-double Mesh :: area( int i )
-// returns area of triangle i in the original mesh
+void Mesh :: buildLaplacian( void )
+// builds the cotan-Laplace operator, made strictly positive-definite
+// according to the Poisson constraint: the final row and column are
+// omitted (pin), or a small multiple of the diagonal is added (shift); the
+// mean-zero constraint factors the pinned matrix and recovers the final
+// vertex from a Schur complement (see solveLaplacian())
 {
-   Vector& p1 = vertices[ faces[i].vertex[0] ].im();
-   Vector& p2 = vertices[ faces[i].vertex[1] ].im();
-   Vector& p3 = vertices[ faces[i].vertex[2] ].im();
+   // relative diagonal shift for the shifted formulation
+   const double shift = 1e-8;
+
+   // allocate a sparse |V|x|V| matrix (or (|V|-1)x(|V|-1) if pinned)
+   int nV = vertices.size();
+   int pinned = poissonConstraint == constrainShift ? -1 : nV-1;
+   int n = pinned == -1 ? nV : nV-1;
+   QuaternionMatrix L0( common );
+   L0.resize( n, n );
+
+   // visit each edge
+   for( size_t e = 0; e < edges.size(); e++ )
+   {
+      int k1 = edges[e].vertex[0];
+      int k2 = edges[e].vertex[1];
+      double w = edges[e].weight;
+
+      // add contribution of this edge to the matrix
+      if( k1 != pinned && k2 != pinned ) L0( k1, k2 ) -= w;
+      if( k2 != pinned && k1 != pinned ) L0( k2, k1 ) -= w;
+      if( k1 != pinned ) L0( k1, k1 ) += w;
+      if( k2 != pinned ) L0( k2, k2 ) += w;
+   }
+
+   if( poissonConstraint == constrainShift )
+   {
+      for( int i = 0; i < n; i++ )
+      {
+         L0( i, i ) *= 1. + shift;
+      }
+   }
+
+   // build Cholesky factorization (or have each worker factor its patch)
+   Upper& A( L0.toReal() );
+   laplacianMemory = L0.peakMemory();
+   if( domainL.nPatches() > 0 )
+   {
+      vector<int> patch;
+      rowPatches( n, patch );
+      domainL.build( A, patch );
+   }
+   else
+   {
+      setBoundaryConstraints( L, n );
+      L.build( A, connectivityKey + " L" );
+   }
 
-   return .5 * (( p2-p1 ) ^ ( p3-p1 )).norm();
+   if( poissonConstraint == constrainMeanZero )
+   {
+      buildBorder();
+   }
 }
 
-void Mesh :: buildEigenvalueProblem( void )
+void Mesh :: buildBorder( void )
+// precomputes the solutions of L_p w = l and L_p w = 1 and the inverse of
+// the Schur complement used by solveLaplacian() for the mean-zero
+// constraint, where L_p is the pinned Laplacian and l is its final column
 {
-   // allocate a sparse |V|x|V| matrix
-   int nV = vertices.size();
-   QuaternionMatrix E0;
-   E0.resize( nV, nV );
+   int n = vertices.size() - 1;
 
-   // visit each face
-   for( size_t k = 0; k < faces.size(); k++ )
+   // final column of L (and its diagonal entry)
+   borderColumn.assign( n, 0. );
+   double diagonal = 0.;
+   for( size_t e = 0; e < edges.size(); e++ )
    {
-      double A = area(k);
-      double a = -1. / (4.*A);
-      double b = rho[k] / 6.;
-      double c = A*rho[k]*rho[k] / 9.;
+      int k1 = edges[e].vertex[0];
+      int k2 = edges[e].vertex[1];
+      double w = edges[e].weight;
+      if( k1 == n ) { borderColumn[k2] -= w; diagonal += w; }
+      if( k2 == n ) { borderColumn[k1] -= w; diagonal += w; }
+   }
 
-      // get vertex indices
-      int I[3] =
+   // solve L_p w = l and L_p w = 1 (as real quaternions)
+   vector<Quaternion> b( n+1 ), w;
+   for( int k = 0; k < 2; k++ )
+   {
+      for( int i = 0; i < n; i++ )
       {
-         faces[k].vertex[0],
-         faces[k].vertex[1],
-         faces[k].vertex[2]
-      };
+         b[i] = k == 0 ? borderColumn[i] : 1.;
+      }
+      solvePinned( w, b );
 
-      // compute edges across from each vertex
-      Quaternion e[3];
-      for( int i = 0; i < 3; i++ )
+      borderW[k].resize( n );
+      for( int i = 0; i < n; i++ )
       {
-         e[i] = vertices[ I[ (i+2) % 3 ]] -
-                vertices[ I[ (i+1) % 3 ]] ;
+         borderW[k][i] = w[i].re();
       }
+   }
 
-      // increment matrix entry for each ordered pair of vertices
-      for( int i = 0; i < 3; i++ )
-      for( int j = 0; j < 3; j++ )
+   // Schur complement S = [ L_aa 1; 1 0 ] - B' W, with B = [ l 1 ]
+   double S[2][2] = { { diagonal, 1. }, { 1., 0. } };
+   for( int i = 0; i < n; i++ )
+   {
+      double B[2] = { borderColumn[i], 1. };
+      for( int j = 0; j < 2; j++ )
+      for( int k = 0; k < 2; k++ )
       {
-         E0(I[i],I[j]) += a*e[i]*e[j] + b*(e[j]-e[i]) + c;
+         S[j][k] -= B[j] * borderW[k][i];
       }
    }
 
-   // build Cholesky factorization
-   E.build( E0.toReal() );
+   double det = S[0][0]*S[1][1] - S[0][1]*S[1][0];
+   if( det == 0. )
+   {
+      throw Error( "singular Schur complement in mean-zero Poisson problem" );
+   }
+   borderInverse[0][0] =  S[1][1] / det;
+   borderInverse[0][1] = -S[0][1] / det;
+   borderInverse[1][0] = -S[1][0] / det;
+   borderInverse[1][1] =  S[0][0] / det;
 }
 
-void Mesh :: buildPoissonProblem( void )
+void Mesh :: projectPoisson( vector<Quaternion>& x ) const
+// projects x onto the space on which the Poisson solve inverts L: vectors
+// whose final entry is zero (pin), with zero mean (mean zero), or all
+// vectors (shift)
 {
-   buildOmega();
+   if( poissonConstraint == constrainPin )
+   {
+      x.back() = 0.;
+   }
+   else if( poissonConstraint == constrainMeanZero )
+   {
+      removeMean( x );
+   }
 }
 
-void Mesh :: buildLaplacian( void )
-// builds the cotan-Laplace operator, where the final row and
-// column are omitted to make the system strictly positive-
-// definite (equivalent to setting the final degree of freedom
-// to zero)
+double Mesh :: poissonConditionNumber( int nIterations )
+// estimates the condition number of the Poisson operator
 {
-   // allocate a sparse |V|x|V| matrix
+   if( !components.empty() )
+   {
+      double kappa = 0.;
+      for( size_t c = 0; c < components.size(); c++ )
+      {
+         kappa = max( kappa, components[c]->poissonConditionNumber( nIterations ));
+      }
+      return kappa;
+   }
+
    int nV = vertices.size();
-   QuaternionMatrix L0;
-   L0.resize( nV-1, nV-1 );
+   if( nV == 0 ) return 0.;
 
-   // visit each face
-   for( size_t i = 0; i < faces.size(); i++ )
+   // the Laplacian acts on each imaginary component separately; start
+   // from a fixed vector with no particular structure
+   vector<Quaternion> v0( nV ), v, w;
+   for( int i = 0; i < nV; i++ )
    {
-      // visit each triangle corner
-      for( int j = 0; j < 3; j++ )
-      {
-         // get vertex indices
-         int k0 = faces[i].vertex[ (j+0) % 3 ];
-         int k1 = faces[i].vertex[ (j+1) % 3 ];
-         int k2 = faces[i].vertex[ (j+2) % 3 ];
+      v0[i] = Quaternion( 0., sin( i+1. ), cos( 2.*i+1. ), sin( 3.*i+2. ));
+   }
+   projectPoisson( v0 );
 
-         // get vertex positions
-         Vector f0 = vertices[k0].im();
-         Vector f1 = vertices[k1].im();
-         Vector f2 = vertices[k2].im();
+   // largest eigenvalue via power iteration (the shift is ignored, since
+   // it barely changes the largest eigenvalue)
+   vector<double> x( 3*nV ), y( 3*nV );
+   double lambdaMax = 0.;
+   v = v0;
+   for( int k = 0; k < nIterations; k++ )
+   {
+      double vNorm = 0.;
+      for( int i = 0; i < nV; i++ ) vNorm += v[i].norm2();
+      vNorm = sqrt( vNorm );
+      if( vNorm == 0. ) return 0.;
 
-         // compute cotangent of the angle at the current vertex
-         // (equal to cosine over sine, which equals the dot
-         // product over the norm of the cross product)
-         Vector u1 = f1 - f0;
-         Vector u2 = f2 - f0;
-         double cotAlpha = (u1*u2)/(u1^u2).norm();
+      for( int i = 0; i < nV; i++ )
+      {
+         const Vector& vi( v[i].im() );
+         x[ i*3+0 ] = vi.x / vNorm;
+         x[ i*3+1 ] = vi.y / vNorm;
+         x[ i*3+2 ] = vi.z / vNorm;
+      }
+      applyLaplacian( x, y );
 
-         // add contribution of this cotangent to the matrix
-         if( k1 != nV-1 && k2 != nV-1 ) L0( k1, k2 ) -= cotAlpha / 2.;
-         if( k2 != nV-1 && k1 != nV-1 ) L0( k2, k1 ) -= cotAlpha / 2.;
-         if( k1 != nV-1 && k1 != nV-1 ) L0( k1, k1 ) += cotAlpha / 2.;
-         if( k2 != nV-1 && k2 != nV-1 ) L0( k2, k2 ) += cotAlpha / 2.;
+      for( int i = 0; i < nV; i++ )
+      {
+         v[i] = Quaternion( 0., y[ i*3+0 ], y[ i*3+1 ], y[ i*3+2 ] );
       }
+      projectPoisson( v );
+
+      lambdaMax = 0.;
+      for( int i = 0; i < nV; i++ ) lambdaMax += v[i].norm2();
+      lambdaMax = sqrt( lambdaMax );
    }
-   
-   // build Cholesky factorization
-   L.build( L0.toReal() );
+
+   // largest eigenvalue of the inverse via inverse iteration
+   double muMax = 0.;
+   v = v0;
+   for( int k = 0; k < nIterations; k++ )
+   {
+      double vNorm = 0.;
+      for( int i = 0; i < nV; i++ ) vNorm += v[i].norm2();
+      vNorm = sqrt( vNorm );
+      for( int i = 0; i < nV; i++ ) v[i] /= vNorm;
+
+      solveLaplacian( w, v );
+      w.resize( nV, 0. );
+      projectPoisson( w );
+      v.swap( w );
+
+      muMax = 0.;
+      for( int i = 0; i < nV; i++ ) muMax += v[i].norm2();
+      muMax = sqrt( muMax );
+   }
+
+   return lambdaMax * muMax;
 }
 
 void Mesh :: buildOmega( void )
 {
    int nV = vertices.size();
+   int nE = edges.size();
 
-   // clear omega
-   for( size_t i = 0; i < omega.size(); i++ )
+   // compute weighted, transformed vector along each edge
+   vector<Quaternion> eTilde( nE );
+   #pragma omp parallel for
+   for( int k = 0; k < nE; k++ )
    {
-      omega[i] = 0.;
+      int a = edges[k].vertex[0];
+      int b = edges[k].vertex[1];
+
+      // compute transformed edge vector
+      Quaternion lambda1 = lambda[a];
+      Quaternion lambda2 = lambda[b];
+      Quaternion e = vertices[b] - vertices[a];
+      eTilde[k] = (1./3.) * (~lambda1) * e * lambda1 +
+                  (1./6.) * (~lambda1) * e * lambda2 +
+                  (1./6.) * (~lambda2) * e * lambda1 +
+                  (1./3.) * (~lambda2) * e * lambda2 ;
+
+      eTilde[k] *= edges[k].weight;
    }
 
-   // visit each face
-   for( size_t i = 0; i < faces.size(); i++ )
+   // sum contributions of incident edges to the divergence at each vertex
+   #pragma omp parallel for
+   for( int i = 0; i < nV; i++ )
    {
-      // get indices of the vertices of this face
-      int v[3] = { faces[i].vertex[0],
-                   faces[i].vertex[1],
-                   faces[i].vertex[2] };
-
-      // visit each edge
-      for( int j = 0; j < 3; j++ )
+      omega[i] = 0.;
+      for( int k = adjacencyStart[i]; k < adjacencyStart[i+1]; k++ )
       {
-         // get vertices
-         Quaternion f0 = vertices[ v[ (j+0) % 3 ]];
-         Quaternion f1 = vertices[ v[ (j+1) % 3 ]];
-         Quaternion f2 = vertices[ v[ (j+2) % 3 ]];
-
-         // determine orientation of this edge
-         int a = v[ (j+1) % 3 ];
-         int b = v[ (j+2) % 3 ];
-         if( a > b )
-         {
-            swap( a, b );
-         }
-
-         // compute transformed edge vector
-         Quaternion lambda1 = lambda[a];
-         Quaternion lambda2 = lambda[b];
-         Quaternion e = vertices[b] - vertices[a];
-         Quaternion eTilde = (1./3.) * (~lambda1) * e * lambda1 +
-                             (1./6.) * (~lambda1) * e * lambda2 +
-                             (1./6.) * (~lambda2) * e * lambda1 +
-                             (1./3.) * (~lambda2) * e * lambda2 ;
-
-         // compute cotangent of the angle opposite the current edge
-         Vector u1 = ( f1 - f0 ).im();
-         Vector u2 = ( f2 - f0 ).im();
-         double cotAlpha = (u1*u2)/(u1^u2).norm();
-
-         // add contribution of this edge to the divergence at its vertices
-         if( a != nV-1 ) omega[a] -= cotAlpha * eTilde / 2.;
-         if( b != nV-1 ) omega[b] += cotAlpha * eTilde / 2.;
+         // edges point from lower to higher vertex index
+         if( adjacency[k] > i ) omega[i] -= eTilde[ adjacentEdges[k] ];
+         else                   omega[i] += eTilde[ adjacentEdges[k] ];
       }
    }
 }
 
 void Mesh :: normalizeSolution( void )
 {
+   int nV = vertices.size();
+
    // center vertices around the origin
-   removeMean( newVertices );
+   double center[3] = { 0., 0., 0. };
+   for( int i = 0; i < nV; i++ )
+   for( int k = 0; k < 3; k++ )
+   {
+      center[k] += newPositions[ i*3+k ];
+   }
+
+   for( int i = 0; i < nV; i++ )
+   for( int k = 0; k < 3; k++ )
+   {
+      newPositions[ i*3+k ] -= center[k] / (double) nV;
+   }
 
    // find the vertex with the largest norm
    double r = 0.;
-   for( size_t i = 0; i < vertices.size(); i++ )
+   for( int i = 0; i < nV; i++ )
    {
-      r = max( r, newVertices[i].norm2() );
+      const double* p = &newPositions[ i*3 ];
+      r = max( r, p[0]*p[0] + p[1]*p[1] + p[2]*p[2] );
    }
    r = sqrt(r);
 
    // rescale so that vertices have norm at most one
-   for( size_t i = 0; i < vertices.size(); i++ )
+   for( int i = 0; i < 3*nV; i++ )
    {
-      newVertices[i] /= r;
+      newPositions[i] /= r;
    }
 }
 
 
 // FILE I/O --------------------------------------------------------------------
 
-void Mesh :: read( const string& filename )
+void Mesh :: read( const string& filename, VertexOrdering ordering )
 // loads a triangle mesh in Wavefront OBJ format
 {
    // open mesh file
    ifstream in( filename.c_str() );
    if( !in.is_open() )
    {
-      cerr << "Error: couldn't open file ";
-      cerr << filename;
-      cerr << " for input!" << endl;
-      exit( 1 );
+      throw Error( "couldn't open file " + filename + " for input" );
    }
 
+   vertices.clear();
+   faces.clear();
+
    // temporary list of vertex coordinates
    vector<Vector> uv;
 
@@ -296,7 +1884,6 @@ void Mesh :: read( const string& filename )
          line >> x >> y >> z;
 
          vertices.push_back( Quaternion( 0., x, y, z ));
-         newVertices.push_back( Quaternion( 0., x, y, z ));
       }
       if( token == "vt" ) // texture coordinate
       {
@@ -329,6 +1916,10 @@ void Mesh :: read( const string& filename )
 
             if( I[1] != -1 )
             {
+               if( I[1] < 1 || I[1] > (int) uv.size() )
+               {
+                  throw Error( "invalid texture coordinate index in " + filename );
+               }
                triangle.uv[i] = uv[ I[1]-1 ];
             }
          }
@@ -337,41 +1928,200 @@ void Mesh :: read( const string& filename )
       }
    }
 
+   initialize( ordering );
+}
+
+void Mesh :: build( const double* positions, int nVertices,
+                    const int* indices, int nFaces,
+                    VertexOrdering ordering )
+// builds a triangle mesh from in-memory arrays of vertex positions
+// (x,y,z for each vertex) and zero-based vertex indices (three per face)
+{
+   vertices.resize( nVertices );
+   for( int i = 0; i < nVertices; i++ )
+   {
+      const double* p = &positions[ i*3 ];
+      vertices[i] = Quaternion( 0., p[0], p[1], p[2] );
+   }
+
+   faces.resize( nFaces );
+   for( int i = 0; i < nFaces; i++ )
+   for( int j = 0; j < 3; j++ )
+   {
+      faces[i].vertex[j] = indices[ i*3+j ];
+      faces[i].uv[j] = Vector( 0., 0., 0. );
+   }
+
+   initialize( ordering );
+}
+
+void Mesh :: getPositions( double* positions, bool originalOrder ) const
+// copies the coordinates of the deformed vertices into a caller-provided
+// array of 3*nVertices values
+{
+   for( size_t i = 0; i < vertices.size(); i++ )
+   {
+      double* p = &positions[ 3*( originalOrder ? originalVertex[i] : i ) ];
+      p[0] = newPositions[ i*3+0 ];
+      p[1] = newPositions[ i*3+1 ];
+      p[2] = newPositions[ i*3+2 ];
+   }
+}
+
+void Mesh :: getPositions( float* positions, bool originalOrder ) const
+// copies the coordinates of the deformed vertices into a caller-provided
+// array of 3*nVertices values
+{
+   for( size_t i = 0; i < vertices.size(); i++ )
+   {
+      float* p = &positions[ 3*( originalOrder ? originalVertex[i] : i ) ];
+      p[0] = (float) newPositions[ i*3+0 ];
+      p[1] = (float) newPositions[ i*3+1 ];
+      p[2] = (float) newPositions[ i*3+2 ];
+   }
+}
+
+Vector Mesh :: newVertex( int i ) const
+// returns the deformed position of vertex i
+{
+   return Vector( newPositions[ i*3+0 ],
+                  newPositions[ i*3+1 ],
+                  newPositions[ i*3+2 ] );
+}
+
+void Mesh :: initialize( VertexOrdering ordering )
+// validates a newly loaded mesh, and precomputes all data that
+// depends only on the original geometry
+{
+   int nV = vertices.size();
+   int nF = faces.size();
+
+   if( nV < 3 || nF < 1 )
+   {
+      throw Error( "mesh must contain at least one triangle" );
+   }
+
+   for( int i = 0; i < nF; i++ )
+   for( int j = 0; j < 3; j++ )
+   {
+      if( faces[i].vertex[j] < 0 || faces[i].vertex[j] >= nV )
+      {
+         throw Error( "face has a vertex index out of range" );
+      }
+   }
+
+   // keep track of the original order
+   originalVertex.resize( nV );
+   originalFace.resize( nF );
+   for( int i = 0; i < nV; i++ ) originalVertex[i] = i;
+   for( int i = 0; i < nF; i++ ) originalFace[i] = i;
+
+   // improve memory locality
+   if( ordering != orderOriginal )
+   {
+      reorder( ordering );
+   }
+
    // allocate space for mesh attributes
+   rhoFactored.clear();
+   newPositions.resize( 3*vertices.size() );
    lambda.resize( vertices.size() );
-   omega.resize( vertices.size()-1 );
+   omega.resize( vertices.size() );
    rho.resize( faces.size() );
-   normalizeSolution();
+   resetDeformation();
+
+   // precompute geometric quantities and connectivity
+   buildGeometry();
+   buildConnectivity();
+
+   Hash hash;
+   hash.add( nV );
+   for( int i = 0; i < nF; i++ )
+   {
+      hash.add( faces[i].vertex, sizeof( faces[i].vertex ));
+   }
+   connectivityKey = hash.hex();
+
+   // a mesh with several connected components is split into independent
+   // subproblems (since a single pinned vertex would leave the Laplacian
+   // singular on all other components); otherwise, prefactor the
+   // Laplace matrix
+   clearComponents();
+   domainL.stop();
+   domainE.stop();
+   if( findComponents() > 1 )
+   {
+      buildComponents();
+   }
+   else
+   {
+      // with domain decomposition, start the workers before any
+      // matrices are assembled (see DomainSolver::start())
+      if( nPatches > 1 )
+      {
+         partitionVertices();
+         domainL.start( nPatches );
+         if( eigensolver == eigensolveInverse )
+         {
+            domainE.start( nPatches );
+         }
+      }
+
+      buildLaplacian();
+   }
+}
 
-   // prefactor Laplace matrix
-   buildLaplacian();
+void Mesh :: write( const string& filename, bool originalOrder )
+// saves a triangle mesh in Wavefront OBJ format, using the vertex
+// and face order of the original file unless "originalOrder" is false
+{
+   write( filename, newPositions, originalOrder );
 }
 
-void Mesh :: write( const string& filename )
-// saves a triangle mesh in Wavefront OBJ format
+void Mesh :: write( const string& filename, const vector<double>& positions,
+                    bool originalOrder ) const
+// saves a triangle mesh with the specified vertex positions
 {
    ofstream out( filename.c_str() );
 
    if( !out.is_open() )
    {
-      cerr << "Error: couldn't open file ";
-      cerr << filename;
-      cerr << " for output!" << endl;
-      return;
+      throw Error( "couldn't open file " + filename + " for output" );
    }
 
-   for( size_t i = 0; i < vertices.size(); i++ )
+   int nV = vertices.size();
+   int nF = faces.size();
+
+   // determine the position of each vertex and face in the output
+   vector<int> vertexIndex( nV ), faceOrder( nF );
+   for( int i = 0; i < nV; i++ )
    {
-      out << "v " << newVertices[i].im().x << " "
-                  << newVertices[i].im().y << " "
-                  << newVertices[i].im().z << endl;
+      vertexIndex[i] = originalOrder ? originalVertex[i] : i;
+   }
+   for( int i = 0; i < nF; i++ )
+   {
+      faceOrder[ originalOrder ? originalFace[i] : i ] = i;
+   }
+   vector<int> vertexOrder( nV );
+   for( int i = 0; i < nV; i++ )
+   {
+      vertexOrder[ vertexIndex[i] ] = i;
    }
 
-   for( size_t i = 0; i < faces.size(); i++ )
+   for( int k = 0; k < nV; k++ )
+   {
+      int i = vertexOrder[k];
+      out << "v " << positions[ i*3+0 ] << " "
+                  << positions[ i*3+1 ] << " "
+                  << positions[ i*3+2 ] << endl;
+   }
+
+   for( int k = 0; k < nF; k++ )
    {
-      out << "f " << 1+faces[i].vertex[0] << " "
-                  << 1+faces[i].vertex[1] << " "
-                  << 1+faces[i].vertex[2] << endl;
+      int i = faceOrder[k];
+      out << "f " << 1+vertexIndex[ faces[i].vertex[0] ] << " "
+                  << 1+vertexIndex[ faces[i].vertex[1] ] << " "
+                  << 1+vertexIndex[ faces[i].vertex[2] ] << endl;
    }
 }
 
@@ -0,0 +1,121 @@
+// =============================================================================
+// SpinXForm -- PointCache.cpp
+//
+
+#include <cstring>
+#include "PointCache.h"
+#include "Utility.h"
+#include "Error.h"
+
+template <class T>
+static void writeLittleEndian( ofstream& out, T x )
+// writes a four-byte value in little-endian byte order
+{
+   char* c = (char*) &x;
+   if( bigEndian() )
+   {
+      std::swap( c[0], c[3] );
+      std::swap( c[1], c[2] );
+   }
+   out.write( c, 4 );
+}
+
+PointCache :: PointCache( void )
+// creates a closed point cache
+: nPoints( 0 ),
+  nSamples( 0 )
+{}
+
+PointCache :: ~PointCache( void )
+// closes the file, if open
+{
+   if( out.is_open() )
+   {
+      close();
+   }
+}
+
+void PointCache :: open( const string& _filename, int _nPoints,
+                         double startFrame, double sampleRate )
+// creates the file and writes the header
+{
+   if( out.is_open() )
+   {
+      close();
+   }
+
+   filename = _filename;
+   nPoints = _nPoints;
+   nSamples = 0;
+
+   out.open( filename.c_str(), ios::out | ios::binary | ios::trunc );
+   if( !out.is_open() )
+   {
+      throw Error( "couldn't open file " + filename + " for output" );
+   }
+
+   // signature (including the terminating null) and version
+   char signature[12];
+   memset( signature, 0, 12 );
+   strcpy( signature, "POINTCACHE2" );
+   out.write( signature, 12 );
+   writeLittleEndian<int>( out, 1 );
+
+   writeLittleEndian<int>( out, nPoints );
+   writeLittleEndian<float>( out, startFrame );
+   writeLittleEndian<float>( out, sampleRate );
+   writeLittleEndian<int>( out, nSamples ); // (updated by close())
+
+   if( !out )
+   {
+      throw Error( "couldn't write to file " + filename );
+   }
+}
+
+void PointCache :: write( const float* positions )
+// appends a frame of 3*nPoints coordinates
+{
+   if( !out.is_open() )
+   {
+      throw Error( "point cache is not open" );
+   }
+
+   const float* data = positions;
+   if( bigEndian() )
+   {
+      buffer.assign( positions, positions + 3*nPoints );
+      for( size_t i = 0; i < buffer.size(); i++ )
+      {
+         swapFloat( buffer[i] );
+      }
+      data = &buffer[0];
+   }
+
+   out.write( (const char*) data, 3*nPoints*sizeof(float) );
+   if( !out )
+   {
+      throw Error( "couldn't write to file " + filename );
+   }
+   nSamples++;
+}
+
+void PointCache :: close( void )
+// records the number of frames in the header and closes the file
+{
+   if( !out.is_open() )
+   {
+      return;
+   }
+
+   // the frame count is the final field of the 32-byte header
+   out.seekp( 28 );
+   writeLittleEndian<int>( out, nSamples );
+   out.close();
+}
+
+int PointCache :: nFrames( void ) const
+// returns the number of frames written so far
+{
+   return nSamples;
+}
+
@@ -0,0 +1,113 @@
+// =============================================================================
+// SpinXForm -- Pool.cpp
+//
+
+#include <algorithm>
+#include "Pool.h"
+
+using namespace std;
+
+const size_t Pool::alignment;
+const size_t Pool::maxObjectSize;
+
+Pool :: Pool( size_t _chunkSize )
+// creates an empty pool
+: chunkSize( max( _chunkSize, maxObjectSize )),
+  current( 0 ),
+  offset( 0 ),
+  freeLists( maxObjectSize/alignment + 1, (void*) NULL ),
+  used( 0 ),
+  peak( 0 )
+{}
+
+Pool :: ~Pool( void )
+// returns all chunks to the system
+{
+   for( size_t i = 0; i < chunks.size(); i++ )
+   {
+      ::operator delete( chunks[i] );
+   }
+}
+
+void* Pool :: allocate( size_t size )
+// returns storage for an object of the specified size
+{
+   size = ( size + alignment-1 ) / alignment * alignment;
+   used += size;
+   peak = max( peak, used );
+
+   if( size > maxObjectSize )
+   {
+      return ::operator new( size );
+   }
+
+   // reuse a free object of the same size, if any
+   void*& head( freeLists[ size/alignment ] );
+   if( head )
+   {
+      void* p = head;
+      head = *(void**) p;
+      return p;
+   }
+
+   // otherwise, move on to the next chunk if the current one is full
+   // (reserving a new chunk only if all existing ones are in use)
+   if( current == chunks.size() || offset + size > chunkSize )
+   {
+      if( current < chunks.size() ) current++;
+      if( current == chunks.size() )
+      {
+         chunks.push_back( (char*) ::operator new( chunkSize ));
+      }
+      offset = 0;
+   }
+
+   void* p = chunks[ current ] + offset;
+   offset += size;
+   return p;
+}
+
+void Pool :: deallocate( void* p, size_t size )
+// returns the storage of an object
+{
+   size = ( size + alignment-1 ) / alignment * alignment;
+   used -= size;
+
+   if( size > maxObjectSize )
+   {
+      ::operator delete( p );
+      return;
+   }
+
+   void*& head( freeLists[ size/alignment ] );
+   *(void**) p = head;
+   head = p;
+}
+
+void Pool :: reset( void )
+// makes all chunks available again
+{
+   current = 0;
+   offset = 0;
+   fill( freeLists.begin(), freeLists.end(), (void*) NULL );
+   used = 0;
+}
+
+size_t Pool :: usage( void ) const
+// returns the number of bytes currently allocated
+{
+   return used;
+}
+
+size_t Pool :: peakUsage( void ) const
+// returns the maximum number of bytes allocated at any one time
+{
+   return peak;
+}
+
+size_t Pool :: capacity( void ) const
+// returns the number of bytes reserved in chunks
+{
+   return chunks.size() * chunkSize;
+}
+
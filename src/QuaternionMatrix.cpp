@@ -14,7 +14,13 @@ Quaternion QuaternionMatrix::zero( 0., 0., 0., 0. );
 
 extern cm::Common cc;
 QuaternionMatrix :: QuaternionMatrix( void )
-: A( cc, 0, 0 )
+: data( EntryMap::key_compare(), EntryMap::allocator_type( &pool )),
+  A( cc, 0, 0 )
+{}
+
+QuaternionMatrix :: QuaternionMatrix( cm::Common& common )
+: data( EntryMap::key_compare(), EntryMap::allocator_type( &pool )),
+  A( common, 0, 0 )
 {}
 
 void QuaternionMatrix :: resize( int _m, int _n )
@@ -22,7 +28,11 @@ void QuaternionMatrix :: resize( int _m, int _n )
 {
    m = _m;
    n = _n;
+
+   // (entries are returned to the pool, which hands out the same
+   // memory again for the next assembly)
    data.clear();
+   pool.reset();
 }
 
 int QuaternionMatrix :: size( int dim ) const
@@ -39,13 +49,14 @@ Quaternion& QuaternionMatrix :: operator()( int row, int col )
 {
    EntryIndex index( col, row );
 
-   EntryMap::const_iterator entry = data.find( index );
-   if( entry == data.end())
+   // find the entry, inserting a zero if necessary (with a single search)
+   EntryMap::iterator entry = data.lower_bound( index );
+   if( entry == data.end() || entry->first != index )
    {
-      data[ index ] = Quaternion( 0., 0., 0., 0. );
+      entry = data.insert( entry, EntryMap::value_type( index, Quaternion( 0., 0., 0., 0. )));
    }
 
-   return data[ index ];
+   return entry->second;
 }
 
 const Quaternion& QuaternionMatrix :: operator()( int row, int col ) const
@@ -63,7 +74,7 @@ const Quaternion& QuaternionMatrix :: operator()( int row, int col ) const
    return entry->second;
 }
 
-cm::Upper& QuaternionMatrix :: toReal( void )
+cm::Upper& QuaternionMatrix :: toReal( bool keepZeros )
 // returns real matrix where each quaternion becomes a 4x4 block
 {
    double Q[4][4];
@@ -79,7 +90,7 @@ cm::Upper& QuaternionMatrix :: toReal( void )
       for( int u = 0; u < 4; u++ )
       for( int v = 0; v < 4; v++ )
       {
-         if( Q[u][v] != 0. )
+         if( Q[u][v] != 0. || keepZeros )
          {
             A( i*4+u, j*4+v ) = Q[u][v];
          }
@@ -89,3 +100,21 @@ cm::Upper& QuaternionMatrix :: toReal( void )
    return A;
 }
 
+size_t QuaternionMatrix :: peakMemory( void ) const
+// returns the largest number of bytes ever used to store entries
+{
+   return pool.peakUsage() + A.peakMemory();
+}
+
+QuaternionMatrix::const_iterator QuaternionMatrix :: begin( void ) const
+// returns an iterator to the first nonzero entry
+{
+   return data.begin();
+}
+
+QuaternionMatrix::const_iterator QuaternionMatrix :: end( void ) const
+// returns an iterator past the last nonzero entry
+{
+   return data.end();
+}
+
@@ -0,0 +1,220 @@
+// =============================================================================
+// SpinXForm -- ResultCache.cpp
+//
+// Each entry holds a header -- a format tag, the signature, and the number
+// of values -- followed by the raw values (native doubles); since entries
+// only ever appear through rename(), a file of the right size is always
+// complete.
+//
+
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include "ResultCache.h"
+#include "MappedFile.h"
+#include "Error.h"
+
+// file name extension of entries
+static const string extension( ".xyz" );
+
+// header at the start of each entry
+class EntryHeader
+{
+   public:
+      char tag[8]; // format tag (see entryTag)
+      ResultCache::Signature signature;
+      uint64_t nValues;
+};
+static const char entryTag[8] = { 'S', 'X', 'C', 'A', 'C', 'H', 'E', '1' };
+
+ResultCache::Signature :: Signature( void )
+// creates an empty signature
+: nVertices( 0 ),
+  nFaces( 0 ),
+  check( 0 )
+{}
+
+bool ResultCache::Signature :: operator==( const Signature& s ) const
+// returns whether all fields are equal
+{
+   return nVertices == s.nVertices && nFaces == s.nFaces && check == s.check;
+}
+
+ResultCache :: ResultCache( void )
+// creates a cache without a directory
+: nHits( 0 ),
+  nMisses( 0 ),
+  capacity( 0 )
+{}
+
+void ResultCache :: open( const string& _directory, size_t _capacity )
+// uses the specified directory, creating it if necessary
+{
+   directory = _directory;
+   capacity = _capacity;
+
+   if( mkdir( directory.c_str(), 0777 ) != 0 && errno != EEXIST )
+   {
+      throw Error( "couldn't create cache directory " + directory );
+   }
+}
+
+bool ResultCache :: fetch( const string& key, const Signature& signature, vector<double>& values )
+// reads an entry and marks it most recently used
+{
+   string filename = path( key );
+   size_t size = values.size()*sizeof(double);
+
+   // (an entry whose signature does not match belongs to other inputs
+   // that happen to have the same key)
+   MappedFile file;
+   bool found = file.open( filename ) && file.size() == sizeof(EntryHeader) + size;
+   const EntryHeader* header = (const EntryHeader*) file.data();
+   if( found )
+   {
+      found = memcmp( header->tag, entryTag, sizeof(entryTag) ) == 0 &&
+              header->signature == signature &&
+              header->nValues == values.size();
+   }
+   if( !found )
+   {
+      nMisses++;
+      return false;
+   }
+
+   if( !values.empty() )
+   {
+      memcpy( &values[0], header+1, size );
+   }
+   file.close();
+
+   // (the modification time records the last use)
+   utime( filename.c_str(), NULL );
+
+   nHits++;
+   return true;
+}
+
+bool ResultCache :: store( const string& key, const Signature& signature, const vector<double>& values )
+// writes an entry and evicts least recently used entries
+{
+   // write to a temporary file (unique to this process), then move it
+   // into place
+   stringstream temporary;
+   temporary << directory << "/." << key << "." << getpid();
+
+   ofstream out( temporary.str().c_str(), ios::binary );
+   if( !out.is_open() )
+   {
+      return false;
+   }
+   EntryHeader header;
+   memcpy( header.tag, entryTag, sizeof(entryTag) );
+   header.signature = signature;
+   header.nValues = values.size();
+   out.write( (const char*) &header, sizeof(header) );
+   if( !values.empty() )
+   {
+      out.write( (const char*) &values[0], values.size()*sizeof(double) );
+   }
+   out.close();
+
+   if( out.fail() || rename( temporary.str().c_str(), path( key ).c_str() ) != 0 )
+   {
+      unlink( temporary.str().c_str() );
+      return false;
+   }
+
+   evict();
+   return true;
+}
+
+size_t ResultCache :: size( void )
+// returns the total number of bytes of all entries
+{
+   vector<Entry> entries;
+   list( entries );
+
+   size_t total = 0;
+   for( size_t i = 0; i < entries.size(); i++ )
+   {
+      total += entries[i].size;
+   }
+   return total;
+}
+
+bool ResultCache::Entry :: operator<( const Entry& e ) const
+// orders entries from least to most recently used
+{
+   if( time != e.time ) return time < e.time;
+   return path < e.path;
+}
+
+void ResultCache :: list( vector<Entry>& entries )
+// finds all entries in the cache directory
+{
+   entries.clear();
+
+   DIR* dir = opendir( directory.c_str() );
+   if( dir == NULL ) return;
+
+   struct dirent* d;
+   while(( d = readdir( dir )) != NULL )
+   {
+      // (skip temporary files, which start with a dot)
+      string name( d->d_name );
+      if( name[0] == '.' ||
+          name.size() <= extension.size() ||
+          name.compare( name.size()-extension.size(), extension.size(), extension ) != 0 )
+      {
+         continue;
+      }
+
+      Entry entry;
+      entry.path = directory + "/" + name;
+
+      struct stat s;
+      if( stat( entry.path.c_str(), &s ) != 0 ) continue;
+      entry.size = s.st_size;
+      entry.time = s.st_mtime;
+      entries.push_back( entry );
+   }
+
+   closedir( dir );
+}
+
+void ResultCache :: evict( void )
+// deletes least recently used entries until the cache fits
+{
+   vector<Entry> entries;
+   list( entries );
+
+   size_t total = 0;
+   for( size_t i = 0; i < entries.size(); i++ )
+   {
+      total += entries[i].size;
+   }
+   if( total <= capacity ) return;
+
+   sort( entries.begin(), entries.end() );
+   for( size_t i = 0; i < entries.size() && total > capacity; i++ )
+   {
+      // (another process may have deleted the entry already)
+      unlink( entries[i].path.c_str() );
+      total -= entries[i].size;
+   }
+}
+
+string ResultCache :: path( const string& key ) const
+// returns the file name of the entry with the specified key
+{
+   return directory + "/" + key + extension;
+}
+
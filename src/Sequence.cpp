@@ -0,0 +1,203 @@
+// =============================================================================
+// SpinXForm -- Sequence.cpp
+//
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <algorithm>
+#include "Sequence.h"
+#include "PointCache.h"
+#include "Image.h"
+#include "Utility.h"
+
+Sequence :: Sequence( Mesh& _mesh )
+// creates an empty sequence for the specified mesh
+: sampling( Mesh::sampleCorners ),
+  mesh( _mesh )
+{}
+
+void Sequence :: readSchedule( const string& filename )
+// reads keyframes from a schedule file
+{
+   ifstream in( filename.c_str() );
+   if( !in.is_open() )
+   {
+      throw Error( "couldn't open file " + filename );
+   }
+
+   keyframes.clear();
+
+   string line;
+   int lineNumber = 0;
+   while( getline( in, line ))
+   {
+      lineNumber++;
+
+      // strip comments and skip blank lines
+      size_t comment = line.find( '#' );
+      if( comment != string::npos ) line.erase( comment );
+      if( line.find_first_not_of( " \t\r" ) == string::npos ) continue;
+
+      stringstream ss( line );
+      Keyframe keyframe;
+      if( !( ss >> keyframe.frame >> keyframe.source ))
+      {
+         stringstream message;
+         message << "malformed keyframe on line " << lineNumber << " of " << filename;
+         throw Error( message.str() );
+      }
+
+      if( !( ss >> keyframe.scale ))
+      {
+         keyframe.scale = isRawArray( keyframe.source ) ? 1. : 5.;
+      }
+
+      keyframes.push_back( keyframe );
+   }
+
+   if( keyframes.empty() )
+   {
+      throw Error( "no keyframes in " + filename );
+   }
+
+   stable_sort( keyframes.begin(), keyframes.end(), earlier );
+}
+
+void Sequence :: setFrames( const string& pattern, int first, int count )
+// uses one keyframe per frame, named according to a printf-style pattern
+{
+   // (the pattern becomes the format string of snprintf())
+   if( !isIndexPattern( pattern ))
+   {
+      throw Error( "image pattern " + pattern + " must contain exactly one integer conversion, e.g., bump%04d.tga" );
+   }
+
+   keyframes.clear();
+
+   vector<char> name( pattern.size() + 64 );
+   for( int i = 0; i < count; i++ )
+   {
+      Keyframe keyframe;
+      keyframe.frame = first + i;
+      snprintf( &name[0], name.size(), pattern.c_str(), keyframe.frame );
+      keyframe.source = &name[0];
+      keyframe.scale = isRawArray( keyframe.source ) ? 1. : 5.;
+      keyframes.push_back( keyframe );
+   }
+}
+
+void Sequence :: run( const string& filename )
+// computes every frame and writes the deformed vertices to a point cache
+{
+   if( keyframes.empty() )
+   {
+      throw Error( "sequence has no frames" );
+   }
+
+   int nV = mesh.vertices.size();
+   int nK = keyframes.size();
+   int first = keyframes.front().frame;
+   int last = keyframes.back().frame;
+
+   PointCache cache;
+   cache.open( filename, nV, first );
+
+   // rho is interpolated between keyframes k and k+1 (rho0 and rho1),
+   // and each keyframe is loaded only once
+   vector<double> rho0, rho1;
+   vector<float> positions( 3*nV );
+   int k = 0, loaded = -1;
+
+   // (the settings of the mesh are restored on every exit, including
+   // errors)
+   bool verbose = mesh.verbose;
+   bool warmStart = mesh.warmStart;
+   mesh.verbose = false;
+   mesh.warmStart = true;
+
+   try
+   {
+      for( int frame = first; frame <= last; frame++ )
+      {
+         while( k+1 < nK && keyframes[k+1].frame <= frame ) k++;
+
+         if( loaded != k )
+         {
+            if( loaded >= 0 && loaded+1 == k ) rho0.swap( rho1 );
+            else load( keyframes[k], rho0 );
+            if( k+1 < nK ) load( keyframes[k+1], rho1 );
+            loaded = k;
+         }
+
+         if( k+1 < nK )
+         {
+            double t = (double) ( frame - keyframes[k].frame ) /
+                       (double) ( keyframes[k+1].frame - keyframes[k].frame );
+            for( size_t i = 0; i < rho0.size(); i++ )
+            {
+               mesh.rho[i] = (1.-t)*rho0[i] + t*rho1[i];
+            }
+         }
+         else
+         {
+            mesh.rho = rho0;
+         }
+
+         double t0 = wallClock();
+         mesh.updateDeformation();
+         mesh.getPositions( &positions[0] );
+         cache.write( &positions[0] );
+         double t1 = wallClock();
+
+         if( verbose )
+         {
+            cout << "frame " << frame << ": " << t1-t0 << "s" << endl;
+         }
+      }
+
+      cache.close();
+   }
+   catch( ... )
+   {
+      mesh.verbose = verbose;
+      mesh.warmStart = warmStart;
+      throw;
+   }
+
+   mesh.verbose = verbose;
+   mesh.warmStart = warmStart;
+
+   if( verbose )
+   {
+      cout << "wrote " << last-first+1 << " frames to " << filename << endl;
+   }
+}
+
+bool Sequence :: earlier( const Keyframe& a, const Keyframe& b )
+// orders keyframes by frame number
+{
+   return a.frame < b.frame;
+}
+
+void Sequence :: load( const Keyframe& keyframe, vector<double>& rho )
+// computes the values of rho for a keyframe
+{
+   if( isRawArray( keyframe.source ))
+   {
+      if( !mesh.readCurvatureChange( keyframe.source, keyframe.scale ))
+      {
+         throw Error( "couldn't read rho from " + keyframe.source );
+      }
+   }
+   else
+   {
+      Image image;
+      image.read( keyframe.source.c_str() );
+      mesh.setCurvatureChange( image, keyframe.scale, sampling );
+   }
+
+   rho = mesh.rho;
+}
+
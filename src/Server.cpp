@@ -0,0 +1,318 @@
+// =============================================================================
+// SpinXForm -- Server.cpp
+//
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <exception>
+#include "Server.h"
+#include "Image.h"
+#include "Utility.h"
+
+Server :: Server( int _capacity )
+// creates a server that keeps at most "capacity" meshes in memory
+: resultCache( NULL ),
+  capacity( max( 1, _capacity ))
+{}
+
+Server :: ~Server( void )
+// releases all cached meshes
+{
+   for( EntryList::iterator e = entries.begin(); e != entries.end(); e++ )
+   {
+      delete e->second;
+   }
+}
+
+bool Server :: run( const string& path )
+// listens on the specified socket path and processes requests until
+// a "shutdown" request is received
+{
+   Socket listener;
+   if( !listener.listen( path ))
+   {
+      cerr << "Error: couldn't listen on socket " << path << "!" << endl;
+      return false;
+   }
+
+   cout << "listening on " << path << endl;
+
+   bool running = true;
+   while( running )
+   {
+      Socket client;
+      if( !listener.accept( client ))
+      {
+         continue;
+      }
+
+      running = serve( client );
+   }
+
+   return true;
+}
+
+bool Server :: serve( Socket& client )
+// processes requests from a single client
+{
+   string request;
+   bool done = false;
+
+   while( !done && client.readLine( request ))
+   {
+      try
+      {
+         if( !handle( client, request, done ))
+         {
+            return false;
+         }
+      }
+      catch( const Error& e )
+      {
+         client.writeLine( string( "error " ) + e.what() );
+      }
+      catch( const std::exception& e )
+      {
+         // (e.g., running out of memory should only fail this request)
+         client.writeLine( string( "error " ) + e.what() );
+      }
+   }
+
+   return true;
+}
+
+static bool canOpen( const string& filename )
+// returns true if the specified file can be opened for reading
+{
+   ifstream in( filename.c_str() );
+   return in.is_open();
+}
+
+bool Server :: handle( Socket& client, const string& request, bool& done )
+// processes a single request
+{
+   stringstream in( request );
+   string command, name;
+   in >> command >> name;
+
+   if( command == "quit" )
+   {
+      client.writeLine( "ok" );
+      done = true;
+      return true;
+   }
+
+   if( command == "shutdown" )
+   {
+      client.writeLine( "ok" );
+      done = true;
+      return false;
+   }
+
+   if( command == "list" )
+   {
+      string reply = "ok";
+      for( EntryList::iterator e = entries.begin(); e != entries.end(); e++ )
+      {
+         reply += " " + e->first;
+      }
+      client.writeLine( reply );
+      return true;
+   }
+
+   if( name.empty() )
+   {
+      client.writeLine( "error missing mesh name" );
+      return true;
+   }
+
+   if( command == "load" )
+   {
+      string filename;
+      in >> filename;
+      if( !canOpen( filename ))
+      {
+         client.writeLine( "error couldn't open " + filename );
+         return true;
+      }
+
+      Mesh* mesh = new Mesh;
+      mesh->setResultCache( resultCache );
+      try
+      {
+         mesh->read( filename );
+      }
+      catch( ... )
+      {
+         delete mesh;
+         throw;
+      }
+      insert( name, mesh );
+
+      stringstream reply;
+      reply << "ok " << mesh->vertices.size() << " " << mesh->faces.size();
+      client.writeLine( reply.str() );
+      return true;
+   }
+
+   if( command == "unload" )
+   {
+      remove( name );
+      client.writeLine( "ok" );
+      return true;
+   }
+
+   Mesh* mesh = find( name );
+
+   if( command == "rho" )
+   {
+      // check the size before reading (or allocating) anything; if the
+      // request is rejected, the payload cannot be skipped safely, so the
+      // connection is dropped
+      size_t n = 0;
+      in >> n;
+      if( !mesh || n != mesh->faces.size() )
+      {
+         client.writeLine( mesh ? "error expected one value of rho per face"
+                                : "error unknown mesh " + name );
+         done = true;
+         return true;
+      }
+
+      vector<double> rho( n );
+      if( n > 0 && !client.read( &rho[0], n*sizeof(double) ))
+      {
+         done = true;
+         return true;
+      }
+
+      mesh->rho = rho;
+      client.writeLine( "ok" );
+      return true;
+   }
+
+   if( !mesh )
+   {
+      client.writeLine( "error unknown mesh " + name );
+      return true;
+   }
+
+   if( command == "image" )
+   {
+      string filename, samplingName = "corners";
+      double scale = 5.;
+      in >> filename >> scale >> samplingName;
+      if( !canOpen( filename ))
+      {
+         client.writeLine( "error couldn't open " + filename );
+         return true;
+      }
+
+      Mesh::CurvatureSampling sampling;
+      if(      samplingName == "corners" ) sampling = Mesh::sampleCorners;
+      else if( samplingName == "mipmap"  ) sampling = Mesh::sampleMipmap;
+      else if( samplingName == "area"    ) sampling = Mesh::sampleArea;
+      else
+      {
+         client.writeLine( "error unknown sampling " + samplingName );
+         return true;
+      }
+
+      Image image;
+      image.read( filename.c_str() );
+      mesh->setCurvatureChange( image, scale, sampling );
+      client.writeLine( "ok" );
+      return true;
+   }
+
+   if( command == "rhofile" )
+   {
+      string filename;
+      double scale = 1.;
+      in >> filename >> scale;
+      if( !mesh->readCurvatureChange( filename, scale ))
+      {
+         client.writeLine( "error couldn't read rho from " + filename );
+         return true;
+      }
+
+      client.writeLine( "ok" );
+      return true;
+   }
+
+   if( command == "deform" )
+   {
+      double t0 = wallClock();
+      mesh->updateDeformation();
+      double t1 = wallClock();
+
+      stringstream reply;
+      reply << "ok " << t1-t0;
+      client.writeLine( reply.str() );
+      return true;
+   }
+
+   if( command == "fetch" )
+   {
+      // (meshes are loaded in file order, so the deformed positions
+      // can be sent without reordering or copying)
+      size_t nV = mesh->vertices.size();
+
+      stringstream reply;
+      reply << "ok " << nV;
+      client.writeLine( reply.str() );
+      if( nV > 0 )
+      {
+         client.write( &mesh->newPositions[0], 3*nV*sizeof(double) );
+      }
+      return true;
+   }
+
+   client.writeLine( "error unknown command " + command );
+   return true;
+}
+
+Mesh* Server :: find( const string& name )
+// returns the named mesh (or NULL) and marks it most recently used
+{
+   map<string,EntryList::iterator>::iterator i = index.find( name );
+   if( i == index.end() )
+   {
+      return NULL;
+   }
+
+   // move entry to the front of the list
+   entries.splice( entries.begin(), entries, i->second );
+   return i->second->second;
+}
+
+void Server :: insert( const string& name, Mesh* mesh )
+// adds a mesh to the cache, evicting the least recently used
+// mesh if the cache is full
+{
+   remove( name );
+
+   while( (int) entries.size() >= capacity )
+   {
+      remove( entries.back().first );
+   }
+
+   entries.push_front( Entry( name, mesh ));
+   index[ name ] = entries.begin();
+}
+
+void Server :: remove( const string& name )
+// removes a mesh from the cache
+{
+   map<string,EntryList::iterator>::iterator i = index.find( name );
+   if( i == index.end() )
+   {
+      return;
+   }
+
+   delete i->second->second;
+   entries.erase( i->second );
+   index.erase( i );
+}
+
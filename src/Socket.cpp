@@ -0,0 +1,248 @@
+// =============================================================================
+// SpinXForm -- Socket.cpp
+//
+
+#include <cstring>
+#include <algorithm>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "Socket.h"
+
+Socket :: Socket( void )
+// creates a closed socket
+: fd( -1 )
+{}
+
+Socket :: ~Socket( void )
+// closes the socket, if open
+{
+   close();
+}
+
+#ifdef MSG_NOSIGNAL
+// (writing to a closed connection fails with EPIPE instead of raising
+// SIGPIPE, without changing the signal disposition of the whole process)
+static const int sendFlags = MSG_NOSIGNAL;
+#else
+static const int sendFlags = 0;
+#endif
+
+static void disableSigPipe( int fd )
+// suppresses SIGPIPE on platforms without MSG_NOSIGNAL (e.g., Mac OS X)
+{
+#ifdef SO_NOSIGPIPE
+   int on = 1;
+   setsockopt( fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof( on ));
+#else
+   (void) fd;
+#endif
+}
+
+static bool makeAddress( const string& path, sockaddr_un& address )
+// fills in a Unix-domain address, returning false if the path is too long
+{
+   memset( &address, 0, sizeof( address ));
+   address.sun_family = AF_UNIX;
+
+   if( path.size() >= sizeof( address.sun_path ))
+   {
+      return false;
+   }
+
+   strcpy( address.sun_path, path.c_str() );
+   return true;
+}
+
+bool Socket :: listen( const string& _path )
+// binds to the specified path and starts listening for connections;
+// any stale socket file at this path is removed first
+{
+   close();
+
+   sockaddr_un address;
+   if( !makeAddress( _path, address ))
+   {
+      return false;
+   }
+
+   fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+   if( fd < 0 )
+   {
+      return false;
+   }
+
+   unlink( _path.c_str() );
+   if( bind( fd, (sockaddr*) &address, sizeof( address )) != 0 ||
+       ::listen( fd, 8 ) != 0 )
+   {
+      close();
+      return false;
+   }
+
+   path = _path;
+   return true;
+}
+
+bool Socket :: accept( Socket& client )
+// waits for the next connection and hands it to "client"
+{
+   client.close();
+
+   int c;
+   do
+   {
+      c = ::accept( fd, NULL, NULL );
+   }
+   while( c < 0 && errno == EINTR );
+
+   if( c < 0 )
+   {
+      return false;
+   }
+
+   client.fd = c;
+   disableSigPipe( c );
+   return true;
+}
+
+bool Socket :: connect( const string& _path )
+// connects to a server listening at the specified path
+{
+   close();
+
+   sockaddr_un address;
+   if( !makeAddress( _path, address ))
+   {
+      return false;
+   }
+
+   fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+   if( fd < 0 )
+   {
+      return false;
+   }
+
+   if( ::connect( fd, (sockaddr*) &address, sizeof( address )) != 0 )
+   {
+      close();
+      return false;
+   }
+
+   disableSigPipe( fd );
+   return true;
+}
+
+bool Socket :: pair( Socket& other )
+// connects this socket and "other" to each other
+{
+   close();
+   other.close();
+
+   int fds[2];
+   if( socketpair( AF_UNIX, SOCK_STREAM, 0, fds ) != 0 )
+   {
+      return false;
+   }
+
+   fd = fds[0];
+   other.fd = fds[1];
+   disableSigPipe( fd );
+   disableSigPipe( other.fd );
+   return true;
+}
+
+void Socket :: close( void )
+// closes the connection (and removes the socket file if listening)
+{
+   if( fd >= 0 )
+   {
+      ::close( fd );
+      fd = -1;
+   }
+
+   if( !path.empty() )
+   {
+      unlink( path.c_str() );
+      path.clear();
+   }
+
+   buffer.clear();
+}
+
+bool Socket :: isOpen( void ) const
+// returns true if the socket is connected or listening
+{
+   return fd >= 0;
+}
+
+bool Socket :: readLine( string& line )
+// reads a single line (without the trailing newline)
+{
+   const size_t chunkSize = 4096;
+   char chunk[ chunkSize ];
+
+   size_t end;
+   while(( end = buffer.find( '\n' )) == string::npos )
+   {
+      ssize_t n = ::read( fd, chunk, chunkSize );
+      if( n < 0 && errno == EINTR ) continue;
+      if( n <= 0 ) return false;
+      buffer.append( chunk, n );
+   }
+
+   line = buffer.substr( 0, end );
+   buffer.erase( 0, end+1 );
+   return true;
+}
+
+bool Socket :: writeLine( const string& line )
+// writes a single line, appending a newline
+{
+   string s = line + "\n";
+   return write( s.data(), s.size() );
+}
+
+bool Socket :: read( void* data, size_t size )
+// reads exactly "size" bytes
+{
+   char* p = (char*) data;
+
+   // consume any bytes left over from readLine() first
+   size_t n = min( size, buffer.size() );
+   memcpy( p, buffer.data(), n );
+   buffer.erase( 0, n );
+   p += n;
+   size -= n;
+
+   while( size > 0 )
+   {
+      ssize_t m = ::read( fd, p, size );
+      if( m < 0 && errno == EINTR ) continue;
+      if( m <= 0 ) return false;
+      p += m;
+      size -= m;
+   }
+
+   return true;
+}
+
+bool Socket :: write( const void* data, size_t size )
+// writes exactly "size" bytes
+{
+   const char* p = (const char*) data;
+
+   while( size > 0 )
+   {
+      ssize_t m = send( fd, p, size, sendFlags );
+      if( m < 0 && errno == EINTR ) continue;
+      if( m <= 0 ) return false;
+      p += m;
+      size -= m;
+   }
+
+   return true;
+}
+
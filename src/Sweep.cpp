@@ -0,0 +1,252 @@
+// =============================================================================
+// SpinXForm -- Sweep.cpp
+//
+
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <map>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "Sweep.h"
+#include "Image.h"
+#include "Utility.h"
+#include "Error.h"
+
+Sweep :: Sweep( Mesh& _mesh )
+// creates an empty sweep for the specified mesh
+: sampling( Mesh::sampleCorners ),
+  nProcesses( max( 1, (int) sysconf( _SC_NPROCESSORS_ONLN ))),
+  mesh( _mesh )
+{}
+
+void Sweep :: setScales( const string& list )
+// sets the scales from a comma-separated list or an inclusive range
+{
+   scales.clear();
+
+   string s( list );
+   for( size_t i = 0; i < s.size(); i++ )
+   {
+      if( s[i] == ',' || s[i] == ':' ) s[i] = ' ';
+   }
+
+   stringstream ss( s );
+   double value;
+   while( ss >> value )
+   {
+      scales.push_back( value );
+   }
+   if( !ss.eof() || scales.empty() )
+   {
+      throw Error( "malformed list of scales " + list );
+   }
+
+   if( list.find( ':' ) != string::npos )
+   {
+      if( list.find( ',' ) != string::npos || scales.size() != 3 || scales[2] <= 0. )
+      {
+         throw Error( "malformed range of scales " + list + " (expected first:last:step)" );
+      }
+
+      // (allow for roundoff in the number of steps)
+      double first = scales[0], last = scales[1], step = scales[2];
+      int n = (int) floor( ( last - first ) / step + 1e-9 ) + 1;
+
+      scales.clear();
+      for( int k = 0; k < n; k++ )
+      {
+         scales.push_back( first + k*step );
+      }
+      if( scales.empty() )
+      {
+         throw Error( "empty range of scales " + list );
+      }
+   }
+}
+
+void Sweep :: load( const string& source )
+// samples an image, or reads a raw rho file, at unit scale
+{
+   if( isRawArray( source ))
+   {
+      if( !mesh.readCurvatureChange( source, 1. ))
+      {
+         throw Error( "couldn't read rho from " + source );
+      }
+   }
+   else
+   {
+      Image image;
+      image.read( source.c_str() );
+      mesh.setCurvatureChange( image, 1., sampling );
+   }
+
+   rho1 = mesh.rho;
+}
+
+void Sweep :: run( const string& pattern )
+// computes and writes every point of the sweep
+{
+   if( scales.empty() )
+   {
+      throw Error( "sweep has no scales" );
+   }
+   if( rho1.size() != mesh.rho.size() )
+   {
+      throw Error( "sweep has no curvature change" );
+   }
+
+   // (the pattern becomes the format string of snprintf())
+   if( !isIndexPattern( pattern ))
+   {
+      throw Error( "output name " + pattern + " must contain exactly one integer conversion, e.g., result%02d.obj" );
+   }
+
+   int nS = scales.size();
+   vector<string> filenames( nS );
+   vector<char> name( pattern.size() + 64 );
+   for( int k = 0; k < nS; k++ )
+   {
+      snprintf( &name[0], name.size(), pattern.c_str(), k );
+      filenames[k] = &name[0];
+   }
+
+   // (points are not warm-started from each other, so that each result
+   // matches a separate run with the same scale; the settings of the mesh
+   // are restored on every exit, including errors)
+   bool verbose = mesh.verbose;
+   bool warmStart = mesh.warmStart;
+   mesh.verbose = false;
+   mesh.warmStart = false;
+
+   int nFailed = 0;
+   try
+   {
+      // the first point factors both matrices in this process
+      double t0 = wallClock();
+      solve( 0, filenames[0] );
+      double t1 = wallClock();
+      if( verbose )
+      {
+         cout << "scale " << scales[0] << ": " << t1-t0 << "s, wrote " << filenames[0] << endl;
+      }
+
+      if( nProcesses <= 1 )
+      {
+         for( int k = 1; k < nS; k++ )
+         {
+            t0 = wallClock();
+            solve( k, filenames[k] );
+            t1 = wallClock();
+            if( verbose )
+            {
+               cout << "scale " << scales[k] << ": " << t1-t0 << "s, wrote " << filenames[k] << endl;
+            }
+         }
+      }
+      else
+      {
+         // (flush, so that children do not repeat buffered output)
+         cout.flush();
+
+         map<pid_t,int> running; // point solved by each child
+         int next = 1;
+         while( next < nS || !running.empty() )
+         {
+            if( next < nS && (int) running.size() < nProcesses )
+            {
+               pid_t pid = fork();
+               if( pid < 0 )
+               {
+                  cerr << "Error: couldn't start process for scale " << scales[next] << "!" << endl;
+                  nFailed++;
+                  next++;
+                  continue;
+               }
+
+               if( pid == 0 )
+               {
+                  // the children already run in parallel, and fork() leaves
+                  // the thread pools of the parent in an undefined state
+                  // (the first parallel region would hang), so each child
+                  // uses a single thread
+                  Common::setDefaultThreads( 1 );
+
+                  // (exit without running the destructors of the parent's objects)
+                  try
+                  {
+                     solve( next, filenames[next] );
+                  }
+                  catch( const Error& e )
+                  {
+                     cerr << "Error: " << e.what() << "!" << endl;
+                     _exit( 1 );
+                  }
+                  catch( ... )
+                  {
+                     _exit( 1 );
+                  }
+                  _exit( 0 );
+               }
+
+               running[ pid ] = next++;
+               continue;
+            }
+
+            int status;
+            pid_t pid = waitpid( -1, &status, 0 );
+            if( pid < 0 ) break;
+            if( running.count( pid ) == 0 ) continue;
+
+            int k = running[ pid ];
+            running.erase( pid );
+            if( WIFEXITED( status ) && WEXITSTATUS( status ) == 0 )
+            {
+               if( verbose )
+               {
+                  cout << "scale " << scales[k] << ": wrote " << filenames[k] << endl;
+               }
+            }
+            else
+            {
+               cerr << "Error: sweep failed for scale " << scales[k] << "!" << endl;
+               nFailed++;
+            }
+         }
+      }
+   }
+   catch( ... )
+   {
+      mesh.verbose = verbose;
+      mesh.warmStart = warmStart;
+      throw;
+   }
+
+   mesh.verbose = verbose;
+   mesh.warmStart = warmStart;
+
+   if( nFailed > 0 )
+   {
+      stringstream message;
+      message << nFailed << " of " << nS << " points of the sweep failed";
+      throw Error( message.str() );
+   }
+}
+
+void Sweep :: solve( int k, const string& filename )
+// computes point k of the sweep and writes it to a file
+{
+   double scale = scales[k];
+   for( size_t i = 0; i < rho1.size(); i++ )
+   {
+      mesh.rho[i] = scale * rho1[i];
+   }
+
+   mesh.updateDeformation();
+   mesh.write( filename );
+}
+
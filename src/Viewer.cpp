@@ -18,6 +18,9 @@ using namespace std;
 // declare static member variables
 Mesh Viewer::mesh;
 Image Viewer::image;
+string Viewer::rhoFilename;
+Mesh::CurvatureSampling Viewer::sampling = Mesh::sampleCorners;
+double Viewer::scale = 5.;
 double Viewer::uvScale = 1.;
 double Viewer::rhoMax;
 Quaternion Viewer::rLast = 1.;
@@ -29,7 +32,25 @@ int Viewer::tLast;
 Viewer::RenderMode Viewer::mode;
 GLuint Viewer::texture = 0;
 GLuint Viewer::surfaceDL = 0;
+vector<Vector> Viewer::faceNormals;
 vector<Vector> Viewer::vertexNormals;
+FileWatcher Viewer::watcher;
+double Viewer::lastChange = -1.;
+pthread_t Viewer::worker;
+pthread_mutex_t Viewer::stateMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t Viewer::requestCondition = PTHREAD_COND_INITIALIZER;
+int Viewer::requested = 0;
+int Viewer::completed = 0;
+int Viewer::processing = 0;
+bool Viewer::resetRequested = false;
+bool Viewer::resultReady = false;
+vector<double> Viewer::resultPositions;
+vector<double> Viewer::resultRho;
+vector<double> Viewer::displayedPositions;
+vector<double> Viewer::displayedRho;
+
+// time (in seconds) a watched file must be unchanged before it is reloaded
+const double debounceTime = .25;
 
 void Viewer :: init( void )
 {
@@ -37,11 +58,35 @@ void Viewer :: init( void )
    initGL();
 
    mode = renderShaded;
-   computeVertexNormals();
-   mesh.setCurvatureChange( image, 5. );
+   if( rhoFilename.empty() )
+   {
+      mesh.setCurvatureChange( image, scale, sampling );
+   }
+   else if( !mesh.readCurvatureChange( rhoFilename ))
+   {
+      throw Error( "couldn't read rho from " + rhoFilename );
+   }
+   displayedPositions = mesh.newPositions;
+   displayedRho = mesh.rho;
+   computeNormals();
 
    updateDisplayList();
 
+   // reload rho automatically when the file changes
+   string source = rhoFilename.empty() ? image.source() : rhoFilename;
+   if( !watcher.watch( source ))
+   {
+      cerr << "Warning: couldn't watch " << source << " for changes." << endl;
+   }
+
+   // deformations are computed in the background, and abandoned
+   // once a newer request arrives
+   mesh.cancelled = Viewer::isStale;
+   if( pthread_create( &worker, NULL, Viewer::work, NULL ) != 0 )
+   {
+      throw Error( "couldn't start worker thread" );
+   }
+
    glutMainLoop();
 }
 
@@ -203,23 +248,27 @@ void Viewer :: view( int value )
 
 void Viewer :: mTransform( void )
 {
-   reloadImage();
-   mesh.updateDeformation();
-   computeVertexNormals();
-   updateDisplayList();
-   printQCDistortion();
+   requestDeformation();
 }
 
 void Viewer :: mResetMesh( void )
 {
-   mesh.resetDeformation();
-   computeVertexNormals();
-   updateDisplayList();
+   // (the worker owns the mesh, so the reset is queued like a deformation
+   // and shown once the worker publishes it)
+   requestReset();
 }
 
 void Viewer :: mWriteMesh( void )
 {
-   mesh.write( "result.obj" );
+   // (writes the surface on screen, without waiting for the worker)
+   try
+   {
+      mesh.write( "result.obj", displayedPositions );
+   }
+   catch( const Error& e )
+   {
+      cerr << "Error: " << e.what() << "!" << endl;
+   }
 }
 
 void Viewer :: mExit( void )
@@ -386,9 +435,9 @@ void Viewer :: setMeshMaterial( void )
       glEnable( GL_COLOR_MATERIAL );
 
       rhoMax = 0.;
-      for( size_t i = 0; i < mesh.faces.size(); i++ )
+      for( size_t i = 0; i < displayedRho.size(); i++ )
       {
-         rhoMax = max( rhoMax, abs( mesh.rho[i] ));
+         rhoMax = max( rhoMax, abs( displayedRho[i] ));
       }
    }
    else
@@ -429,7 +478,7 @@ void Viewer :: drawMesh( void )
          const double r = .85;
          const double g = .70;
          const double b = .61;
-         double rho = mesh.rho[i] / rhoMax;
+         double rho = displayedRho[i] / rhoMax;
 
          if( rho < 0. )
          {
@@ -456,7 +505,7 @@ void Viewer :: drawMesh( void )
 
       if( mode == renderWireframe )
       {
-         Vector N = faceNormal( i );
+         const Vector& N = faceNormals[i];
          glNormal3dv( &N[0] );
       }
 
@@ -504,7 +553,14 @@ Vector Viewer :: vertex( int faceIndex, int whichVertex )
 {
    Face& face( mesh.faces[ faceIndex ] );
    int i = face.vertex[ whichVertex ];
-   return mesh.newVertices[ i ].im();
+   return deformedVertex( i );
+}
+
+Vector Viewer :: deformedVertex( int i )
+// returns the displayed position of vertex i
+{
+   const double* p = &displayedPositions[ i*3 ];
+   return Vector( p[0], p[1], p[2] );
 }
 
 Vector Viewer :: faceNormal( int faceIndex )
@@ -531,10 +587,20 @@ Vector Viewer :: barycenter( int faceIndex )
    return ( p[0] + p[1] + p[2] ) / 3.;
 }
 
-void Viewer :: computeVertexNormals( void )
+void Viewer :: computeNormals( void )
+// computes face normals of the deformed surface (which are reused
+// for drawing) and accumulates them into vertex normals
 {
+   int nF = mesh.faces.size();
+   faceNormals.resize( nF );
    vertexNormals.resize( mesh.vertices.size());
 
+   #pragma omp parallel for
+   for( int i = 0; i < nF; i++ )
+   {
+      faceNormals[i] = faceNormal( i );
+   }
+
    for( size_t i = 0; i < vertexNormals.size(); i++ )
    {
       vertexNormals[i] = Vector( 0., 0., 0. );
@@ -542,7 +608,7 @@ void Viewer :: computeVertexNormals( void )
 
    for( size_t i = 0; i < mesh.faces.size(); i++ )
    {
-      Vector N = faceNormal( i );
+      const Vector& N = faceNormals[i];
 
       const Face& face( mesh.faces[i] );
 
@@ -586,9 +652,9 @@ double Viewer :: quasiConformalDistortion( int faceIndex )
    Vector p3 = mesh.vertices[ mesh.faces[faceIndex].vertex[2] ].im();
 
    // get deformed vertex positions
-   Vector q1 = mesh.newVertices[ mesh.faces[faceIndex].vertex[0] ].im();
-   Vector q2 = mesh.newVertices[ mesh.faces[faceIndex].vertex[1] ].im();
-   Vector q3 = mesh.newVertices[ mesh.faces[faceIndex].vertex[2] ].im();
+   Vector q1 = deformedVertex( mesh.faces[faceIndex].vertex[0] );
+   Vector q2 = deformedVertex( mesh.faces[faceIndex].vertex[1] );
+   Vector q3 = deformedVertex( mesh.faces[faceIndex].vertex[2] );
    
    // compute edge vectors
    Vector u1 = p2 - p1;
@@ -736,10 +802,136 @@ void Viewer :: printQCDistortion( void )
 
 // IMAGE MAP -------------------------------------------------------------------
 
-void Viewer :: reloadImage( void )
+bool Viewer :: reloadImage( void )
 {
-   image.reload();
-   mesh.setCurvatureChange( image, 5. );
+   // (readCurvatureChange() reports its own errors)
+   if( !rhoFilename.empty() )
+   {
+      return mesh.readCurvatureChange( rhoFilename );
+   }
+
+   // keep the previous image if the file has become unreadable
+   try
+   {
+      image.reload();
+   }
+   catch( const Error& e )
+   {
+      cerr << "Error: " << e.what() << "!" << endl;
+      return false;
+   }
+
+   mesh.setCurvatureChange( image, scale, sampling );
+   return true;
+}
+
+// BACKGROUND DEFORMATION ------------------------------------------------------
+
+void* Viewer :: work( void* )
+// worker thread: reloads rho and computes the deformation whenever a new
+// request arrives, discarding results that became stale
+{
+   pthread_mutex_lock( &stateMutex );
+   while( true )
+   {
+      while( completed == requested )
+      {
+         pthread_cond_wait( &requestCondition, &stateMutex );
+      }
+      int generation = requested;
+      bool reset = resetRequested;
+      processing = generation;
+      pthread_mutex_unlock( &stateMutex );
+
+      bool ok = true;
+      try
+      {
+         if( reset )
+         {
+            mesh.resetDeformation();
+         }
+         else if( reloadImage() )
+         {
+            mesh.updateDeformation();
+         }
+         else
+         {
+            // (nothing changed, so there is nothing to deform)
+            ok = false;
+         }
+      }
+      catch( const Error& e )
+      {
+         cerr << "Error: " << e.what() << "!" << endl;
+         ok = false;
+      }
+
+      pthread_mutex_lock( &stateMutex );
+      if( ok && generation == requested )
+      {
+         resultPositions = mesh.newPositions;
+         resultRho = mesh.rho;
+         resultReady = true;
+      }
+      else if( ok )
+      {
+         cout << "(dropped stale result)" << endl;
+      }
+      completed = max( completed, generation );
+   }
+
+   return NULL;
+}
+
+void Viewer :: requestDeformation( void )
+// asks the worker to reload rho and deform the surface again
+{
+   pthread_mutex_lock( &stateMutex );
+   requested++;
+   resetRequested = false;
+   pthread_cond_signal( &requestCondition );
+   pthread_mutex_unlock( &stateMutex );
+}
+
+void Viewer :: requestReset( void )
+// asks the worker to restore the original surface
+{
+   pthread_mutex_lock( &stateMutex );
+   requested++;
+   resetRequested = true;
+   pthread_cond_signal( &requestCondition );
+   pthread_mutex_unlock( &stateMutex );
+}
+
+bool Viewer :: isStale( void )
+// returns whether the request being processed has been superseded
+{
+   pthread_mutex_lock( &stateMutex );
+   bool stale = processing != requested;
+   pthread_mutex_unlock( &stateMutex );
+
+   return stale;
+}
+
+void Viewer :: checkForResults( void )
+// displays the latest result of the worker, if any
+{
+   pthread_mutex_lock( &stateMutex );
+   bool ready = resultReady;
+   if( ready )
+   {
+      displayedPositions.swap( resultPositions );
+      displayedRho.swap( resultRho );
+      resultReady = false;
+   }
+   pthread_mutex_unlock( &stateMutex );
+
+   if( ready )
+   {
+      computeNormals();
+      updateDisplayList();
+      printQCDistortion();
+   }
 }
 
 // CAMERA CONTROL --------------------------------------------------------------
@@ -814,6 +1006,20 @@ void Viewer :: idle( void )
 
    t0 = t1;
 
+   // once the watched file has been quiet for a moment, reload
+   // rho and deform the surface in the background
+   if( watcher.changed() )
+   {
+      lastChange = wallClock();
+   }
+   if( lastChange >= 0. && wallClock() - lastChange > debounceTime )
+   {
+      lastChange = -1.;
+      requestDeformation();
+   }
+
+   checkForResults();
+
    glutPostRedisplay();
 }
 
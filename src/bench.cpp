@@ -0,0 +1,139 @@
+// =============================================================================
+// SpinXForm -- bench.cpp
+//
+// Benchmark for the deformation pipeline, intended for comparing build
+// configurations (optimization level, LTO, PGO, BLAS, thread counts) and for
+// training profile-guided builds.  For example,
+//
+//    spinxform-bench sphere.obj bumpy.tga 20
+//
+// loads the mesh (timing the Laplace factorization), and then computes the
+// deformation 20 times.  The values of rho are rescaled slightly before each
+// run so that every run refactors the eigenvalue matrix rather than reusing
+// the previous factorization.  Minimum and median times of each stage are
+// reported.  Finally, each way of making the Poisson problem definite (see
+// Mesh::PoissonConstraint) is compared by the time to factor the Laplacian,
+// the time of a Poisson solve, and an estimate of the condition number of
+// the system it inverts.
+//
+
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "Mesh.h"
+#include "Image.h"
+#include "Utility.h"
+
+using namespace std;
+
+static void report( const string& name, vector<double> times )
+// prints the minimum and median of a list of times
+{
+   sort( times.begin(), times.end() );
+   cout << name << ": min " << times.front() << "s, median " << times[ times.size()/2 ] << "s" << endl;
+}
+
+static int run( int argc, char **argv )
+{
+   if( argc < 3 || argc > 4 )
+   {
+      cerr << "usage: " << argv[0] << " mesh.obj image.tga|rho.bin [runs]" << endl;
+      return 1;
+   }
+
+   int runs = argc == 4 ? max( 1, atoi( argv[3] )) : 10;
+
+   // load mesh
+   Mesh mesh;
+   double t0 = wallClock();
+   mesh.read( argv[1] );
+   double t1 = wallClock();
+   cout << "vertices: " << mesh.vertices.size() << ", faces: " << mesh.faces.size() << endl;
+   cout << "load and factor Laplacian: " << t1-t0 << "s" << endl;
+
+   // load image (or raw values of rho)
+   string rhoFile( argv[2] );
+   if( isRawArray( rhoFile ))
+   {
+      if( !mesh.readCurvatureChange( rhoFile ))
+      {
+         return 1;
+      }
+   }
+   else
+   {
+      Image image;
+      image.read( rhoFile.c_str() );
+      mesh.setCurvatureChange( image, 5. );
+   }
+   vector<double> rho0( mesh.rho );
+
+   // compute deformations
+   mesh.verbose = false;
+   vector<double> factor, eigensolve, poisson, total;
+   for( int run = 0; run < runs; run++ )
+   {
+      for( size_t i = 0; i < rho0.size(); i++ )
+      {
+         mesh.rho[i] = rho0[i] * ( 1. + 1e-3*run );
+      }
+
+      mesh.updateDeformation();
+
+      factor.push_back( mesh.factorTime );
+      eigensolve.push_back( mesh.eigensolveTime );
+      poisson.push_back( mesh.poissonTime );
+      total.push_back( mesh.factorTime + mesh.eigensolveTime + mesh.poissonTime );
+   }
+
+   cout << "runs: " << runs << endl;
+   report( "factor", factor );
+   report( "eigensolve", eigensolve );
+   report( "Poisson", poisson );
+   report( "total", total );
+
+   // compare Poisson constraints
+   const Mesh::PoissonConstraint constraints[] =
+   {
+      Mesh::constrainPin,
+      Mesh::constrainShift,
+      Mesh::constrainMeanZero
+   };
+   const char* names[] = { "pin", "shift", "meanzero" };
+   for( int k = 0; k < 3; k++ )
+   {
+      t0 = wallClock();
+      mesh.setPoissonConstraint( constraints[k] );
+      t1 = wallClock();
+
+      vector<double> poisson;
+      for( int run = 0; run < runs; run++ )
+      {
+         mesh.updateDeformation();
+         poisson.push_back( mesh.poissonTime );
+      }
+      sort( poisson.begin(), poisson.end() );
+
+      cout << "Poisson (" << names[k] << "): factor " << t1-t0 << "s"
+           << ", median solve " << poisson[ poisson.size()/2 ] << "s"
+           << ", condition number ~ " << mesh.poissonConditionNumber() << endl;
+   }
+
+   return 0;
+}
+
+int main( int argc, char **argv )
+{
+   try
+   {
+      return run( argc, argv );
+   }
+   catch( const Error& e )
+   {
+      cerr << "Error: " << e.what() << "!" << endl;
+      return 1;
+   }
+}
+
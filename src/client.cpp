@@ -0,0 +1,141 @@
+// =============================================================================
+// SpinXForm -- client.cpp
+//
+// Minimal command-line client for the SpinXForm deformation server (see
+// Server.h).  Each invocation sends a single request; for example
+//
+//    spinxform-client /tmp/spinxform.sock load bumpy sphere.obj
+//    spinxform-client /tmp/spinxform.sock image bumpy bumpy.tga 5
+//    spinxform-client /tmp/spinxform.sock deform bumpy
+//    spinxform-client /tmp/spinxform.sock fetch bumpy result.obj
+//
+// The "rho" request reads its values from a file containing one raw double
+// per face, and "fetch" writes the deformed vertices as OBJ vertex lines
+// (or to standard output if no file is given).
+//
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include "Socket.h"
+
+using namespace std;
+
+int main( int argc, char **argv )
+{
+   if( argc < 3 )
+   {
+      cerr << "usage: " << argv[0] << " socket command [arguments...]" << endl;
+      return 1;
+   }
+
+   Socket server;
+   if( !server.connect( argv[1] ))
+   {
+      cerr << "Error: couldn't connect to " << argv[1] << "!" << endl;
+      return 1;
+   }
+
+   string command = argv[2];
+
+   // forward all arguments except the output file of "fetch"
+   // and the input file of "rho"
+   int nArgs = argc;
+   if(( command == "fetch" || command == "rho" ) && argc == 5 )
+   {
+      nArgs = 4;
+   }
+
+   string request = command;
+   for( int i = 3; i < nArgs; i++ )
+   {
+      request += string( " " ) + argv[i];
+   }
+
+   vector<double> rho;
+   if( command == "rho" )
+   {
+      if( argc != 5 )
+      {
+         cerr << "usage: " << argv[0] << " socket rho name values.bin" << endl;
+         return 1;
+      }
+
+      ifstream in( argv[4], ios_base::binary );
+      if( !in.is_open() )
+      {
+         cerr << "Error: couldn't open file " << argv[4] << " for input!" << endl;
+         return 1;
+      }
+
+      double value;
+      while( in.read( (char*) &value, sizeof(double) ))
+      {
+         rho.push_back( value );
+      }
+
+      stringstream s;
+      s << " " << rho.size();
+      request += s.str();
+   }
+
+   server.writeLine( request );
+   if( !rho.empty() )
+   {
+      server.write( &rho[0], rho.size()*sizeof(double) );
+   }
+
+   string reply;
+   if( !server.readLine( reply ))
+   {
+      cerr << "Error: no reply from server!" << endl;
+      return 1;
+   }
+
+   if( reply.substr( 0, 2 ) != "ok" )
+   {
+      cerr << reply << endl;
+      return 1;
+   }
+
+   if( command == "fetch" )
+   {
+      stringstream s( reply.substr( 2 ));
+      size_t nV = 0;
+      s >> nV;
+
+      vector<double> xyz( 3*nV );
+      if( nV > 0 && !server.read( &xyz[0], xyz.size()*sizeof(double) ))
+      {
+         cerr << "Error: incomplete reply from server!" << endl;
+         return 1;
+      }
+
+      ofstream file;
+      if( argc == 5 )
+      {
+         file.open( argv[4] );
+         if( !file.is_open() )
+         {
+            cerr << "Error: couldn't open file " << argv[4] << " for output!" << endl;
+            return 1;
+         }
+      }
+      ostream& out( argc == 5 ? file : cout );
+
+      for( size_t i = 0; i < nV; i++ )
+      {
+         out << "v " << xyz[i*3+0] << " "
+                     << xyz[i*3+1] << " "
+                     << xyz[i*3+2] << endl;
+      }
+   }
+   else
+   {
+      cout << reply << endl;
+   }
+
+   return 0;
+}
+
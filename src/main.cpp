@@ -5,50 +5,342 @@
 //
 
 #include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <map>
+#include "Server.h"
+#include "Sequence.h"
+#include "Sweep.h"
+#include "ResultCache.h"
+#include "Utility.h"
+#ifndef SPINXFORM_HEADLESS
 #include "Viewer.h"
+#endif
 
 using namespace std;
 
-int main( int argc, char **argv )
+static bool isSequence( const string& filename )
+// animations are written to PC2 point caches
+{
+   size_t dot = filename.rfind( '.' );
+   return dot != string::npos && filename.substr( dot ) == ".pc2";
+}
+
+static void usage( const char* program )
+{
+#ifdef SPINXFORM_HEADLESS
+   cerr << "usage: " << program << " [options] mesh.obj image.tga result.obj" << endl;
+   cerr << "       " << program << " [options] mesh.obj rho.bin result.obj" << endl;
+#else
+   cerr << "usage: " << program << " [options] mesh.obj image.tga [result.obj]" << endl;
+   cerr << "       " << program << " [options] mesh.obj rho.bin [result.obj]" << endl;
+#endif
+   cerr << "       " << program << " [options] mesh.obj frame%04d.tga|schedule.txt result.pc2" << endl;
+   cerr << "       " << program << " [options] --sweep s1,s2,...|first:last:step mesh.obj image.tga|rho.bin result%02d.obj" << endl;
+   cerr << "       " << program << " --server socket [cacheSize]" << endl;
+   cerr << endl;
+   cerr << "options:" << endl;
+   cerr << "   --scale s                        image values are mapped to rho in [-s,s] (default: 5)" << endl;
+   cerr << "   --sampling corners|mipmap|area   how the image is averaged over each face" << endl;
+   cerr << "   --reorder none|rcm|morton        vertex order used internally (output keeps the file order)" << endl;
+   cerr << "   --ordering default|natural|amd|metis|nesdis|camd   fill-reducing ordering for factorizations" << endl;
+   cerr << "   --factorization auto|simplicial|supernodal         factorization mode" << endl;
+   cerr << "   --poisson pin|shift|meanzero     fix the last vertex, shift the diagonal, or solve for zero-mean positions" << endl;
+   cerr << "   --threads n                      threads used by CHOLMOD and the BLAS (default: SPINXFORM_THREADS)" << endl;
+   cerr << "   --eigensolver inverse|lobpcg     inverse iteration (factors E) or factorization-free LOBPCG" << endl;
+   cerr << "   --patches n                      split the mesh into n patches, factored by separate processes" << endl;
+   cerr << "   --frames n                       number of frames of an image sequence (for a .pc2 result)" << endl;
+   cerr << "   --first k                        number of the first frame of an image sequence (default: 0)" << endl;
+   cerr << "   --cache dir                      reuse deformations stored in (and store new ones in) a cache directory" << endl;
+   cerr << "   --cachesize MB                   maximum size of the cache directory (default: 1024)" << endl;
+   cerr << "   --sweep list                     solve once per scale, writing one numbered result per scale" << endl;
+   cerr << "   --jobs n                         number of sweep points solved at once (default: number of processors)" << endl;
+}
+
+static bool parseSampling( const string& name, Mesh::CurvatureSampling& sampling )
+{
+   if( name == "corners" ) { sampling = Mesh::sampleCorners; return true; }
+   if( name == "mipmap"  ) { sampling = Mesh::sampleMipmap;  return true; }
+   if( name == "area"    ) { sampling = Mesh::sampleArea;    return true; }
+   return false;
+}
+
+static bool parseOrdering( const string& name, Mesh::VertexOrdering& ordering )
+{
+   if( name == "none"   ) { ordering = Mesh::orderOriginal; return true; }
+   if( name == "rcm"    ) { ordering = Mesh::orderRCM;      return true; }
+   if( name == "morton" ) { ordering = Mesh::orderMorton;   return true; }
+   return false;
+}
+
+static bool parseFactorOrdering( const string& name, Factor::Ordering& ordering )
+{
+   if( name == "default" ) { ordering = Factor::orderDefault; return true; }
+   if( name == "natural" ) { ordering = Factor::orderNatural; return true; }
+   if( name == "amd"     ) { ordering = Factor::orderAMD;     return true; }
+   if( name == "metis"   ) { ordering = Factor::orderMETIS;   return true; }
+   if( name == "nesdis"  ) { ordering = Factor::orderNESDIS;  return true; }
+   if( name == "camd"    ) { ordering = Factor::orderCAMD;    return true; }
+   return false;
+}
+
+static bool parseFactorMode( const string& name, Factor::Mode& mode )
+{
+   if( name == "auto"       ) { mode = Factor::modeAuto;       return true; }
+   if( name == "simplicial" ) { mode = Factor::modeSimplicial; return true; }
+   if( name == "supernodal" ) { mode = Factor::modeSupernodal; return true; }
+   return false;
+}
+
+static bool parsePoisson( const string& name, Mesh::PoissonConstraint& constraint )
 {
-   if( argc < 3 || argc > 4 )
+   if( name == "pin"      ) { constraint = Mesh::constrainPin;      return true; }
+   if( name == "shift"    ) { constraint = Mesh::constrainShift;    return true; }
+   if( name == "meanzero" ) { constraint = Mesh::constrainMeanZero; return true; }
+   return false;
+}
+
+static bool parseEigensolver( const string& name, Mesh::Eigensolver& method )
+{
+   if( name == "inverse" ) { method = Mesh::eigensolveInverse; return true; }
+   if( name == "lobpcg"  ) { method = Mesh::eigensolveLOBPCG;  return true; }
+   return false;
+}
+
+static int run( int argc, char **argv )
+{
+   // split the command line into options (of the form "--name value")
+   // and file arguments
+   const char* knownOptions[] = { "server", "sampling", "reorder", "ordering", "factorization", "poisson", "threads", "eigensolver", "patches", "frames", "first", "scale", "sweep", "jobs", "cache", "cachesize", NULL };
+   map<string,string> options;
+   vector<string> args;
+   for( int i = 1; i < argc; i++ )
+   {
+      string arg( argv[i] );
+      if( arg.substr( 0, 2 ) != "--" )
+      {
+         args.push_back( arg );
+         continue;
+      }
+
+      bool known = false;
+      for( int k = 0; knownOptions[k]; k++ )
+      {
+         known = known || arg.substr( 2 ) == knownOptions[k];
+      }
+      if( !known || i+1 == argc )
+      {
+         usage( argv[0] );
+         return 1;
+      }
+      options[ arg.substr( 2 ) ] = argv[++i];
+   }
+
+   if( options.count( "threads" ))
    {
-      cerr << "usage: " << argv[0] << " mesh.obj image.tga [result.obj]" << endl;
+      Common::setDefaultThreads( atoi( options["threads"].c_str() ));
+   }
+
+   // deformations can be reused across runs via an on-disk cache
+   ResultCache resultCache;
+   ResultCache* cache = NULL;
+   if( options.count( "cache" ))
+   {
+      int megabytes = options.count( "cachesize" ) ? atoi( options["cachesize"].c_str() ) : 1024;
+      if( megabytes <= 0 )
+      {
+         usage( argv[0] );
+         return 1;
+      }
+      resultCache.open( options["cache"], (size_t) megabytes << 20 );
+      cache = &resultCache;
+   }
+
+   if( options.count( "server" )) // server mode
+   {
+      int capacity = args.size() > 0 ? atoi( args[0].c_str() ) : 8;
+      Server server( capacity );
+      server.resultCache = cache;
+      return server.run( options["server"] ) ? 0 : 1;
+   }
+
+   Mesh::CurvatureSampling sampling = Mesh::sampleCorners;
+   if( options.count( "sampling" ) && !parseSampling( options["sampling"], sampling ))
+   {
+      usage( argv[0] );
+      return 1;
+   }
+
+   Mesh::VertexOrdering ordering = Mesh::orderOriginal;
+   if( options.count( "reorder" ) && !parseOrdering( options["reorder"], ordering ))
+   {
+      usage( argv[0] );
+      return 1;
+   }
+
+   Factor::Ordering factorOrdering = Factor::orderDefault;
+   Factor::Mode factorMode = Factor::modeAuto;
+   Mesh::PoissonConstraint poissonConstraint = Mesh::constrainPin;
+   Mesh::Eigensolver eigensolver = Mesh::eigensolveInverse;
+   if(( options.count( "ordering" ) && !parseFactorOrdering( options["ordering"], factorOrdering )) ||
+      ( options.count( "eigensolver" ) && !parseEigensolver( options["eigensolver"], eigensolver )) ||
+      ( options.count( "factorization" ) && !parseFactorMode( options["factorization"], factorMode )) ||
+      ( options.count( "poisson" ) && !parsePoisson( options["poisson"], poissonConstraint )))
+   {
+      usage( argv[0] );
       return 1;
    }
 
-   if( argc == 4 ) // batch mode
+   int nPatches = options.count( "patches" ) ? atoi( options["patches"].c_str() ) : 1;
+   double scale = options.count( "scale" ) ? atof( options["scale"].c_str() ) : 5.;
+
+   if( args.size() < 2 || args.size() > 3 )
+   {
+      usage( argv[0] );
+      return 1;
+   }
+
+   if( args.size() == 3 && options.count( "sweep" )) // sweep mode
+   {
+      // load mesh
+      Mesh mesh;
+      mesh.setFactorOrdering( factorOrdering, factorMode );
+      mesh.setPoissonConstraint( poissonConstraint );
+      mesh.setDomainDecomposition( nPatches );
+      mesh.setEigensolver( eigensolver );
+      mesh.setResultCache( cache );
+      mesh.read( args[0], ordering );
+
+      // sample rho once, then solve for each scale
+      Sweep sweep( mesh );
+      sweep.sampling = sampling;
+      sweep.setScales( options["sweep"] );
+      if( options.count( "jobs" ))
+      {
+         sweep.nProcesses = atoi( options["jobs"].c_str() );
+      }
+      if( nPatches > 1 )
+      {
+         // (domain solver workers cannot be shared between processes)
+         sweep.nProcesses = 1;
+      }
+      sweep.load( args[1] );
+      sweep.run( args[2] );
+      mesh.printFactorStatistics();
+   }
+   else if( args.size() == 3 && isSequence( args[2] )) // sequence mode
+   {
+      // load mesh
+      Mesh mesh;
+      mesh.setFactorOrdering( factorOrdering, factorMode );
+      mesh.setPoissonConstraint( poissonConstraint );
+      mesh.setDomainDecomposition( nPatches );
+      mesh.setEigensolver( eigensolver );
+      mesh.read( args[0], ordering );
+
+      // determine rho for each frame from a pattern or a schedule
+      Sequence sequence( mesh );
+      sequence.sampling = sampling;
+      if( args[1].find( '%' ) != string::npos )
+      {
+         int count = atoi( options["frames"].c_str() );
+         int first = atoi( options["first"].c_str() );
+         if( count <= 0 )
+         {
+            cerr << "Error: please specify the number of frames with --frames!" << endl;
+            return 1;
+         }
+         sequence.setFrames( args[1], first, count );
+      }
+      else
+      {
+         sequence.readSchedule( args[1] );
+      }
+
+      // compute frames and write point cache
+      sequence.run( args[2] );
+      mesh.printFactorStatistics();
+   }
+   else if( args.size() == 3 ) // batch mode
    {
       // load mesh
       Mesh mesh;
-      mesh.read( argv[1] );
+      mesh.setFactorOrdering( factorOrdering, factorMode );
+      mesh.setPoissonConstraint( poissonConstraint );
+      mesh.setDomainDecomposition( nPatches );
+      mesh.setEigensolver( eigensolver );
+      mesh.setResultCache( cache );
+      mesh.read( args[0], ordering );
 
-      // load image
-      Image image;
-      image.read( argv[2] );
+      // load image (or raw values of rho)
+      if( isRawArray( args[1] ))
+      {
+         if( !mesh.readCurvatureChange( args[1] ))
+         {
+            return 1;
+         }
+      }
+      else
+      {
+         Image image;
+         image.read( args[1].c_str() );
+
+         mesh.setCurvatureChange( image, scale, sampling );
+      }
 
       // apply transformation
-      const double scale = 5.;
-      mesh.setCurvatureChange( image, scale );
       mesh.updateDeformation();
+      mesh.printFactorStatistics();
 
       // write result
-      mesh.write( argv[3] );
+      mesh.write( args[2] );
    }
    else // interactive mode
    {
+#ifdef SPINXFORM_HEADLESS
+      cerr << "Error: this build has no viewer; please specify an output file!" << endl;
+      return 1;
+#else
       Viewer viewer;
+      viewer.sampling = sampling;
+      viewer.scale = scale;
 
       // load mesh
-      viewer.mesh.read( argv[1] );
+      viewer.mesh.setFactorOrdering( factorOrdering, factorMode );
+      viewer.mesh.setPoissonConstraint( poissonConstraint );
+      viewer.mesh.setDomainDecomposition( nPatches );
+      viewer.mesh.setEigensolver( eigensolver );
+      viewer.mesh.read( args[0], ordering );
 
-      // load image
-      viewer.image.read( argv[2] );
+      // load image (or raw values of rho)
+      if( isRawArray( args[1] ))
+      {
+         viewer.rhoFilename = args[1];
+      }
+      else
+      {
+         viewer.image.read( args[1].c_str() );
+      }
 
       // start viewer
       viewer.init();
+#endif
    }
 
    return 0;
 }
 
+int main( int argc, char **argv )
+{
+   try
+   {
+      return run( argc, argv );
+   }
+   catch( const Error& e )
+   {
+      cerr << "Error: " << e.what() << "!" << endl;
+      return 1;
+   }
+}
+
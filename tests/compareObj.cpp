@@ -0,0 +1,107 @@
+// =============================================================================
+// SpinXForm -- compareObj.cpp
+//
+// Compares the vertices of two Wavefront OBJ files up to a numeric tolerance,
+// e.g., a computed solution against a reference solution:
+//
+//    compare-obj solution.obj reference_solution.obj 1e-4
+//
+// Returns a nonzero exit status if the files have different numbers of
+// vertices or faces, or if any vertex coordinate differs by more than the
+// tolerance (1e-4 by default).
+//
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+static bool readObj( const char* filename, vector<double>& coordinates, int& nFaces )
+// reads the vertex coordinates and counts the faces of an OBJ file
+{
+   ifstream in( filename );
+   if( !in.is_open() )
+   {
+      cerr << "Error: couldn't open file " << filename << "!" << endl;
+      return false;
+   }
+
+   coordinates.clear();
+   nFaces = 0;
+
+   string line;
+   while( getline( in, line ))
+   {
+      stringstream ss( line );
+      string token;
+      ss >> token;
+
+      if( token == "v" )
+      {
+         double x, y, z;
+         if( !( ss >> x >> y >> z ))
+         {
+            cerr << "Error: malformed vertex in " << filename << "!" << endl;
+            return false;
+         }
+         coordinates.push_back( x );
+         coordinates.push_back( y );
+         coordinates.push_back( z );
+      }
+      else if( token == "f" )
+      {
+         nFaces++;
+      }
+   }
+
+   return true;
+}
+
+int main( int argc, char **argv )
+{
+   if( argc < 3 || argc > 4 )
+   {
+      cerr << "usage: " << argv[0] << " result.obj reference.obj [tolerance]" << endl;
+      return 1;
+   }
+
+   double tolerance = argc == 4 ? atof( argv[3] ) : 1e-4;
+
+   vector<double> x, y;
+   int nFacesX, nFacesY;
+   if( !readObj( argv[1], x, nFacesX ) || !readObj( argv[2], y, nFacesY ))
+   {
+      return 1;
+   }
+
+   if( x.size() != y.size() || nFacesX != nFacesY )
+   {
+      cerr << "Error: meshes differ in size (" << x.size()/3 << " vs. " << y.size()/3
+           << " vertices, " << nFacesX << " vs. " << nFacesY << " faces)!" << endl;
+      return 1;
+   }
+
+   double maxDifference = 0.;
+   bool finite = true;
+   for( size_t i = 0; i < x.size(); i++ )
+   {
+      double d = fabs( x[i] - y[i] );
+      if( d != d ) finite = false; // (NaN)
+      else maxDifference = max( maxDifference, d );
+   }
+
+   cout << "maximum difference: " << maxDifference << " (tolerance " << tolerance << ")" << endl;
+   if( !finite )
+   {
+      cerr << "Error: coordinates are not finite!" << endl;
+      return 1;
+   }
+   return maxDifference <= tolerance ? 0 : 1;
+}
+
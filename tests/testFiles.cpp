@@ -0,0 +1,122 @@
+// =============================================================================
+// SpinXForm -- testFiles.cpp
+//
+// Checks the on-disk formats written by SpinXForm:
+//
+//    - the header and size of a PC2 point cache (PointCache)
+//    - storing, fetching and evicting entries of a ResultCache
+//
+// Files are created in the directory given on the command line (the
+// current directory by default).  Prints one line per check and returns a
+// nonzero exit status if any check fails.
+//
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include "PointCache.h"
+#include "ResultCache.h"
+#include "MappedFile.h"
+#include "Error.h"
+
+using namespace std;
+
+static int nFailed = 0;
+
+static void check( bool passed, const string& name )
+// reports the result of a single check
+{
+   cout << ( passed ? "passed: " : "FAILED: " ) << name << endl;
+   if( !passed ) nFailed++;
+}
+
+static int readInt( const char* p )
+// reads a little-endian 32-bit integer
+{
+   const unsigned char* u = (const unsigned char*) p;
+   return u[0] | ( u[1] << 8 ) | ( u[2] << 16 ) | ( u[3] << 24 );
+}
+
+static void testPointCache( const string& directory )
+{
+   const int nPoints = 5, nFrames = 3;
+   string filename = directory + "/test.pc2";
+
+   PointCache cache;
+   cache.open( filename, nPoints, 10. );
+   vector<float> positions( 3*nPoints );
+   for( int f = 0; f < nFrames; f++ )
+   {
+      for( int i = 0; i < 3*nPoints; i++ ) positions[i] = f + .5f*i;
+      cache.write( &positions[0] );
+   }
+   cache.close();
+
+   MappedFile file;
+   bool ok = file.open( filename );
+   check( ok && file.size() == 32 + nFrames*3*nPoints*sizeof(float), "PC2 file has the expected size" );
+   if( !ok || file.size() < 32 ) return;
+
+   const char* header = (const char*) file.data();
+   check( memcmp( header, "POINTCACHE2", 12 ) == 0, "PC2 signature" );
+   check( readInt( header+12 ) == 1, "PC2 version" );
+   check( readInt( header+16 ) == nPoints, "PC2 number of points" );
+   check( readInt( header+28 ) == nFrames, "PC2 number of frames (updated on close)" );
+}
+
+static void testResultCache( const string& directory )
+{
+   // (room for one entry of three values and its header, but not for two)
+   const size_t capacity = 100;
+   ResultCache cache;
+   cache.open( directory + "/cache", capacity );
+
+   vector<double> values( 3 ), fetched( 3, 0. );
+   values[0] = 1.; values[1] = -2.5; values[2] = 1e-300;
+
+   ResultCache::Signature signature;
+   signature.nVertices = 1;
+   signature.nFaces = 2;
+   signature.check = 12345;
+
+   check( !cache.fetch( "entry1", signature, fetched ), "missing entry is a miss" );
+   check( cache.store( "entry1", signature, values ), "entry is stored" );
+   check( cache.fetch( "entry1", signature, fetched ) && fetched == values, "stored entry is fetched unchanged" );
+
+   vector<double> wrongSize( 4, 0. );
+   check( !cache.fetch( "entry1", signature, wrongSize ), "entry of the wrong size is a miss" );
+
+   ResultCache::Signature other = signature;
+   other.check++;
+   check( !cache.fetch( "entry1", other, fetched ), "entry with a different signature is a miss" );
+
+   // (a second entry exceeds the capacity, so the first one is evicted)
+   check( cache.store( "entry2", signature, values ), "second entry is stored" );
+   check( !cache.fetch( "entry1", signature, fetched ), "least recently used entry is evicted" );
+   check( cache.size() <= capacity, "cache stays within its capacity" );
+}
+
+static int run( int argc, char **argv )
+{
+   string directory = argc > 1 ? argv[1] : ".";
+
+   testPointCache( directory );
+   testResultCache( directory );
+
+   return nFailed == 0 ? 0 : 1;
+}
+
+int main( int argc, char **argv )
+{
+   try
+   {
+      return run( argc, argv );
+   }
+   catch( const Error& e )
+   {
+      cerr << "Error: " << e.what() << "!" << endl;
+      return 1;
+   }
+}
+
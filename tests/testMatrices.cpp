@@ -0,0 +1,256 @@
+// =============================================================================
+// SpinXForm -- testMatrices.cpp
+//
+// Checks the quaternionic solvers against each other on a small test matrix:
+//
+//    - BlockMatrix::multiply() against the product with toReal()
+//    - DomainSolver::solve() against Factor::solve()
+//    - LOBPCG against inverse iteration
+//    - Factor::updown() against factoring the updated matrix
+//
+// The test matrix is a gauge-transformed graph Laplacian A = G'(L + eps I)G
+// on a grid, where G is a diagonal matrix of unit quaternions: its entries
+// are genuinely quaternionic, yet its smallest eigenvalue is known (eps)
+// and well separated from the rest of the spectrum.  Prints one line per
+// check and returns a nonzero exit status if any check fails.
+//
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <utility>
+#include "QuaternionMatrix.h"
+#include "BlockMatrix.h"
+#include "CMWrapper.h"
+#include "DomainSolver.h"
+#include "LinearSolver.h"
+#include "EigenSolver.h"
+#include "Error.h"
+
+using namespace std;
+
+// grid size and smallest eigenvalue of the test matrix
+static const int gridSize = 8;
+static const double eps = 1e-3;
+
+static int nFailed = 0;
+
+static void check( bool passed, const string& name, double value )
+// reports the result of a single check
+{
+   cout << ( passed ? "passed: " : "FAILED: " ) << name << " (" << value << ")" << endl;
+   if( !passed ) nFailed++;
+}
+
+static Quaternion gauge( int i )
+// returns a unit quaternion that varies from vertex to vertex
+{
+   return Quaternion( cos( .3*i ), sin( .7*i ), cos( 1.1*i ), sin( .5*i+1. )).unit();
+}
+
+static void buildTestMatrix( QuaternionMatrix& A )
+// builds G'(L + eps I)G for the Laplacian L of a grid
+{
+   int n = gridSize*gridSize;
+   A.resize( n, n );
+
+   for( int i = 0; i < n; i++ )
+   {
+      A( i, i ) = eps;
+   }
+
+   for( int y = 0; y < gridSize; y++ )
+   for( int x = 0; x < gridSize; x++ )
+   {
+      int i = x + gridSize*y;
+      int neighbors[2] = { x+1 < gridSize ? i+1 : -1,
+                           y+1 < gridSize ? i+gridSize : -1 };
+
+      for( int k = 0; k < 2; k++ )
+      {
+         int j = neighbors[k];
+         if( j < 0 ) continue;
+
+         double w = 1. + .1*((i+j)%3);
+         A( i, i ) += w;
+         A( j, j ) += w;
+         A( i, j ) -= w * (~gauge(i)) * gauge(j);
+         A( j, i ) -= w * (~gauge(j)) * gauge(i);
+      }
+   }
+}
+
+static void testVector( int n, vector<Quaternion>& x )
+// fills x with arbitrary values
+{
+   x.resize( n );
+   for( int i = 0; i < n; i++ )
+   {
+      x[i] = Quaternion( sin( i+1. ), cos( 2.*i ), sin( 3.*i+1. ), cos( .5*i ));
+   }
+}
+
+static double maxDifference( const vector<Quaternion>& x, const vector<Quaternion>& y )
+// returns the largest entrywise difference of two vectors
+{
+   double d = 0.;
+   for( size_t i = 0; i < x.size(); i++ )
+   {
+      d = max( d, ( x[i] - y[i] ).norm() );
+   }
+   return d;
+}
+
+static double rayleighQuotient( const BlockMatrix& A, const vector<Quaternion>& x )
+// returns x'Ax / x'x
+{
+   vector<Quaternion> y;
+   A.multiply( x, y );
+
+   double xAx = 0., xx = 0.;
+   for( size_t i = 0; i < x.size(); i++ )
+   {
+      xAx += ( (~x[i]) * y[i] ).re();
+      xx += x[i].norm2();
+   }
+   return xAx / xx;
+}
+
+static int run( void )
+{
+   Common common;
+   QuaternionMatrix A( common );
+   buildTestMatrix( A );
+   int n = A.size( 1 );
+
+   BlockMatrix B( A );
+   vector<Quaternion> x, b, y;
+   testVector( n, x );
+
+   // BlockMatrix::multiply() vs. the real matrix
+   {
+      B.multiply( x, y );
+
+      vector<Quaternion> z( n );
+      Dense X( common, LinearSolver::toReal( x ), 4*n );
+      Dense Z( common, LinearSolver::toReal( z ), 4*n );
+      double one[2] = { 1., 0. }, zero[2] = { 0., 0. };
+      cholmod_l_sdmult( *A.toReal(), 0, one, zero, *X, *Z, common );
+
+      double d = maxDifference( y, z );
+      check( d < 1e-12, "BlockMatrix::multiply() matches toReal()", d );
+   }
+
+   // DomainSolver vs. Factor
+   {
+      b = y; // (right-hand side with known solution x)
+
+      Factor L( common );
+      L.build( A.toReal() );
+      vector<Quaternion> xFactor;
+      LinearSolver::solve( L, xFactor, b );
+
+      // (two patches: the lower and upper halves of the grid)
+      vector<int> patch( 4*n );
+      for( int i = 0; i < 4*n; i++ )
+      {
+         patch[i] = i < 2*n ? 0 : 1;
+      }
+
+      DomainSolver D;
+      D.start( 2 );
+      D.build( A.toReal(), patch );
+      vector<Quaternion> xDomain;
+      LinearSolver::solve( D, xDomain, b );
+      D.stop();
+
+      double dFactor = maxDifference( xFactor, x );
+      double dDomain = maxDifference( xDomain, xFactor );
+      check( dFactor < 1e-8, "Factor::solve() recovers the solution", dFactor );
+      check( dDomain < 1e-6, "DomainSolver::solve() matches Factor::solve()", dDomain );
+   }
+
+   // LOBPCG vs. inverse iteration
+   {
+      Factor L( common );
+      L.build( A.toReal() );
+      vector<Quaternion> xInverse( n ), xLOBPCG;
+      EigenSolver::solve( L, xInverse );
+      EigenSolver::solve( B, xLOBPCG, false, 1e-8 );
+
+      double cInverse = rayleighQuotient( B, xInverse );
+      double cLOBPCG = rayleighQuotient( B, xLOBPCG );
+      check( fabs( cInverse - eps ) < 1e-2*eps, "inverse iteration finds the smallest eigenvalue", cInverse );
+      check( fabs( cLOBPCG - cInverse ) < 1e-2*eps, "LOBPCG matches inverse iteration", cLOBPCG );
+   }
+
+   // low-rank update (Factor::updown()) vs. factoring the updated matrix
+   {
+      // a rank-two change CC' on a few rows, as in
+      // Mesh::updateEigenvalueProblem()
+      Upper& K( A.toReal() );
+      int nR = 4*n;
+      Sparse C( common, nR, 2 );
+      vector< pair<int,double> > columns[2];
+      for( int r = 0; r < 8; r++ )
+      {
+         columns[0].push_back( make_pair( 4*5  + r, .3 + .1*r  ));
+         columns[1].push_back( make_pair( 4*20 + r, .5 - .05*r ));
+      }
+
+      Upper K2( common, nR, nR );
+      for( Sparse::const_iterator e = K.begin(); e != K.end(); e++ )
+      {
+         K2( e->first.second, e->first.first ) = e->second.first;
+      }
+      for( int j = 0; j < 2; j++ )
+      for( size_t a = 0; a < columns[j].size(); a++ )
+      {
+         C( columns[j][a].first, j ) = columns[j][a].second;
+         for( size_t b = 0; b < columns[j].size(); b++ )
+         {
+            K2( columns[j][a].first, columns[j][b].first ) += columns[j][a].second * columns[j][b].second;
+         }
+      }
+
+      Factor L( common ), L2( common );
+      L.build( K );
+      L2.build( K2 );
+      vector<Quaternion> xExpected, xUpdated, xDowndated, xRefactored;
+      LinearSolver::solve( L2, xExpected, b );
+      double dChange = maxDifference( xExpected, x );
+      check( dChange > 1e-6, "the test update changes the solution", dChange );
+
+      bool updated = L.updown( C, true );
+      LinearSolver::solve( L, xUpdated, b );
+      double dUpdate = maxDifference( xUpdated, xExpected );
+      check( updated && dUpdate < 1e-8, "Factor::updown() update matches factoring A + CC'", dUpdate );
+
+      bool downdated = L.updown( C, false );
+      LinearSolver::solve( L, xDowndated, b );
+      double dDowndate = maxDifference( xDowndated, x );
+      check( downdated && dDowndate < 1e-8, "Factor::updown() downdate recovers the solution", dDowndate );
+
+      // (refactoring after updown() starts over from the original analysis)
+      L.refactor( K2 );
+      LinearSolver::solve( L, xRefactored, b );
+      double dRefactor = maxDifference( xRefactored, xExpected );
+      check( L.succeeded() && dRefactor < 1e-8, "Factor::refactor() after updown() matches build()", dRefactor );
+   }
+
+   return nFailed == 0 ? 0 : 1;
+}
+
+int main( void )
+{
+   try
+   {
+      return run();
+   }
+   catch( const Error& e )
+   {
+      cerr << "Error: " << e.what() << "!" << endl;
+      return 1;
+   }
+}
+